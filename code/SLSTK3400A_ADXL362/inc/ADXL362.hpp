@@ -0,0 +1,429 @@
+/***************************************************************************//**
+ * @file ADXL362.hpp
+ * @brief Header-only C++ driver for the ADXL362 with compile-time settings.
+ * @version 3.2
+ * @author Brecht Van Eeckhoudt
+ *
+ * @details
+ *   The CS pin, range and ODR are template parameters, so the register
+ *   values, conversion factors and thresholds are constants and the hot path
+ *   has no look-ups or if-chains. The transfers go through the C driver
+ *   (transaction queue, DMA, shadow), so the C API keeps working next to
+ *   this one and stays coherent (range, shadow, health monitor).
+ *
+ * @note
+ *   Needs C++11. The conversions don't apply the calibration or the
+ *   temperature compensation of the C driver. This is a layer on top of
+ *   the C driver, not its replacement: the C API isn't a shim around it
+ *   and the firmware build is C only (the host tests compile it).
+ ******************************************************************************/
+
+
+/* Include guards prevent multiple inclusions of the same header */
+#ifndef _ADXL362_HPP_
+#define _ADXL362_HPP_
+
+
+#include "../inc/accel.h"       /* C driver (transport) */
+#include "../inc/pin_mapping.h" /* PORT and PIN definitions */
+
+
+namespace adxl362
+{
+
+/* Register map */
+enum class Reg : uint8_t
+{
+	DEVID_AD       = ADXL_REG_DEVID_AD,
+	DEVID_MST      = ADXL_REG_DEVID_MST,
+	PARTID         = ADXL_REG_PARTID,
+	REVID          = ADXL_REG_REVID,
+	XDATA          = ADXL_REG_XDATA,
+	YDATA          = ADXL_REG_YDATA,
+	ZDATA          = ADXL_REG_ZDATA,
+	STATUS         = ADXL_REG_STATUS,
+	FIFO_ENTRIES_L = ADXL_REG_FIFO_ENTRIES_L,
+	FIFO_ENTRIES_H = ADXL_REG_FIFO_ENTRIES_H,
+	XDATA_L        = ADXL_REG_XDATA_L,
+	XDATA_H        = ADXL_REG_XDATA_H,
+	YDATA_L        = ADXL_REG_YDATA_L,
+	YDATA_H        = ADXL_REG_YDATA_H,
+	ZDATA_L        = ADXL_REG_ZDATA_L,
+	ZDATA_H        = ADXL_REG_ZDATA_H,
+	TEMP_L         = ADXL_REG_TEMP_L,
+	TEMP_H         = ADXL_REG_TEMP_H,
+	SOFT_RESET     = ADXL_REG_SOFT_RESET,
+	THRESH_ACT_L   = ADXL_REG_THRESH_ACT_L,
+	THRESH_ACT_H   = ADXL_REG_THRESH_ACT_H,
+	TIME_ACT       = ADXL_REG_TIME_ACT,
+	THRESH_INACT_L = ADXL_REG_THRESH_INACT_L,
+	THRESH_INACT_H = ADXL_REG_THRESH_INACT_H,
+	TIME_INACT_L   = ADXL_REG_TIME_INACT_L,
+	TIME_INACT_H   = ADXL_REG_TIME_INACT_H,
+	ACT_INACT_CTL  = ADXL_REG_ACT_INACT_CTL,
+	FIFO_CONTROL   = ADXL_REG_FIFO_CONTROL,
+	FIFO_SAMPLES   = ADXL_REG_FIFO_SAMPLES,
+	INTMAP1        = ADXL_REG_INTMAP1,
+	INTMAP2        = ADXL_REG_INTMAP2,
+	FILTER_CTL     = ADXL_REG_FILTER_CTL,
+	POWER_CTL      = ADXL_REG_POWER_CTL,
+	SELF_TEST      = ADXL_REG_SELF_TEST
+};
+
+
+/* Measurement range (FILTER_CTL bits 7:6) */
+enum class Range : uint8_t { G2 = 0, G4 = 1, G8 = 2 };
+
+/* Output data rate (FILTER_CTL bits 2:0) */
+enum class ODR : uint8_t { Hz12_5 = 0, Hz25 = 1, Hz50 = 2, Hz100 = 3, Hz200 = 4, Hz400 = 5 };
+
+/* Measurement mode (POWER_CTL bits 1:0) */
+enum class Mode : uint8_t { Standby = 0b00, Measure = 0b10 };
+
+/* Noise mode (POWER_CTL bits 5:4) */
+enum class Noise : uint8_t { Normal = 0b00, Low = 0b01, UltraLow = 0b10 };
+
+
+/* STATUS bits */
+namespace status
+{
+	constexpr uint8_t DATA_READY     = 0b00000001;
+	constexpr uint8_t FIFO_READY     = 0b00000010;
+	constexpr uint8_t FIFO_WATERMARK = 0b00000100;
+	constexpr uint8_t FIFO_OVERRUN   = 0b00001000;
+	constexpr uint8_t ACT            = 0b00010000;
+	constexpr uint8_t INACT          = 0b00100000;
+	constexpr uint8_t AWAKE          = 0b01000000;
+	constexpr uint8_t ERR_USER_REGS  = 0b10000000;
+}
+
+/* INTMAP1 and INTMAP2 bits */
+namespace intmap
+{
+	constexpr uint8_t DATA_READY     = 0b00000001;
+	constexpr uint8_t FIFO_READY     = 0b00000010;
+	constexpr uint8_t FIFO_WATERMARK = 0b00000100;
+	constexpr uint8_t FIFO_OVERRUN   = 0b00001000;
+	constexpr uint8_t ACT            = 0b00010000;
+	constexpr uint8_t INACT          = 0b00100000;
+	constexpr uint8_t AWAKE          = 0b01000000;
+	constexpr uint8_t INT_LOW        = 0b10000000;
+}
+
+/* ACT_INACT_CTL bits */
+namespace act_inact_ctl
+{
+	constexpr uint8_t ACT_EN         = 0b00000001;
+	constexpr uint8_t ACT_REF        = 0b00000010;
+	constexpr uint8_t INACT_EN       = 0b00000100;
+	constexpr uint8_t INACT_REF      = 0b00001000;
+	constexpr uint8_t LINK_DEFAULT   = (ADXL_LINK_DEFAULT << 4);
+	constexpr uint8_t LINK_LINKED    = (ADXL_LINK_LINKED << 4);
+	constexpr uint8_t LINK_LOOP      = (ADXL_LINK_LOOP << 4);
+}
+
+
+/**************************************************************************//**
+ * @brief
+ *   Build the FILTER_CTL value.
+ *
+ * @param[in] range
+ *   The measurement range.
+ *
+ * @param[in] odr
+ *   The output data rate.
+ *
+ * @param[in] halfBW
+ *   True for a bandwidth at ODR/4, false for ODR/2.
+ *
+ * @return
+ *   The register value.
+ *****************************************************************************/
+constexpr uint8_t filterCtl (Range range, ODR odr, bool halfBW)
+{
+	return ((static_cast<uint8_t>(range) << 6) | ((halfBW ? 1 : 0) << 4) | static_cast<uint8_t>(odr));
+}
+
+
+/**************************************************************************//**
+ * @brief
+ *   Build the POWER_CTL value.
+ *
+ * @param[in] mode
+ *   The measurement mode.
+ *
+ * @param[in] noise
+ *   The noise mode.
+ *
+ * @return
+ *   The register value.
+ *****************************************************************************/
+constexpr uint8_t powerCtl (Mode mode, Noise noise)
+{
+	return ((static_cast<uint8_t>(noise) << 4) | static_cast<uint8_t>(mode));
+}
+
+
+/**************************************************************************//**
+ * @brief
+ *   Get the output data rate.
+ *
+ * @param[in] odr
+ *   The output data rate.
+ *
+ * @return
+ *   The rate [mHz] (up to 400 000, doesn't fit in 16 bits).
+ *****************************************************************************/
+constexpr uint32_t rateMHz (ODR odr)
+{
+	return (12500UL << static_cast<uint8_t>(odr));
+}
+
+static_assert(rateMHz(ODR::Hz12_5) == 12500UL, "ADXL362 rate of ODR::Hz12_5");
+static_assert(rateMHz(ODR::Hz25) == 25000UL, "ADXL362 rate of ODR::Hz25");
+static_assert(rateMHz(ODR::Hz50) == 50000UL, "ADXL362 rate of ODR::Hz50");
+static_assert(rateMHz(ODR::Hz100) == 100000UL, "ADXL362 rate of ODR::Hz100");
+static_assert(rateMHz(ODR::Hz200) == 200000UL, "ADXL362 rate of ODR::Hz200");
+static_assert(rateMHz(ODR::Hz400) == 400000UL, "ADXL362 rate of ODR::Hz400");
+
+
+/**************************************************************************//**
+ * @brief
+ *   ADXL362 on a given CS pin with a fixed range and ODR.
+ *
+ * @details
+ *   All methods are static, a board is a type:
+ *   "using Accel = adxl362::Driver<ADXL_NCS_PORT, ADXL_NCS_PIN, Range::G4, ODR::Hz100>;"
+ *   Every transfer carries the device handle of the CS pin, so it doesn't
+ *   depend on the device selected in the C driver (selectADXL). On
+ *   ADXL_NCS_PIN this is the default device of the C driver (one shadow),
+ *   the others get their own handle, added with initADXL_device by init.
+ *
+ * @tparam CsPort
+ *   The GPIO port of the CS pin.
+ *
+ * @tparam CsPin
+ *   The GPIO pin of the CS pin.
+ *
+ * @tparam R
+ *   The measurement range.
+ *
+ * @tparam O
+ *   The output data rate.
+ *
+ * @tparam HalfBW
+ *   True for a bandwidth at ODR/4 (reset default), false for ODR/2.
+ *****************************************************************************/
+template <GPIO_Port_TypeDef CsPort, unsigned int CsPin, Range R, ODR O, bool HalfBW = true>
+class Driver
+{
+public:
+	/* Register values */
+	static constexpr uint8_t FILTER_CTL = filterCtl(R, O, HalfBW);
+
+	/* Conversion factors */
+	static constexpr int16_t MG_PER_LSB = (1 << static_cast<uint8_t>(R));       /* 12-bit data */
+	static constexpr int16_t MG_PER_LSB8 = (16 << static_cast<uint8_t>(R));     /* 8-bit data (XDATA, YDATA, ZDATA) */
+	static constexpr uint32_t RATE_MHZ = rateMHz(O);                            /* ODR [mHz] */
+	static constexpr uint32_t PERIOD_TICKS = ((ADXL_SYNC_CLOCK * 2) / 25) >> static_cast<uint8_t>(O); /* Sample period [RTC ticks] */
+
+	static_assert(static_cast<uint8_t>(R) <= 2, "ADXL362 range out of bounds");
+	static_assert(static_cast<uint8_t>(O) <= 5, "ADXL362 ODR out of bounds");
+
+
+	/**************************************************************************//**
+	 * @brief
+	 *   Convert a 12-bit value to mg.
+	 *****************************************************************************/
+	static constexpr int16_t toMg (int16_t raw)
+	{
+		return (raw * MG_PER_LSB);
+	}
+
+
+	/**************************************************************************//**
+	 * @brief
+	 *   Convert an 8-bit value (XDATA, YDATA, ZDATA) to mg.
+	 *****************************************************************************/
+	static constexpr int16_t toMg8 (int8_t raw)
+	{
+		return (raw * MG_PER_LSB8);
+	}
+
+
+	/**************************************************************************//**
+	 * @brief
+	 *   Convert a threshold in mg to "codes" (THRESH_ACT, THRESH_INACT).
+	 *****************************************************************************/
+	static constexpr uint16_t thresholdCodes (uint16_t mg)
+	{
+		return (mg >> static_cast<uint8_t>(R));
+	}
+
+
+	/**************************************************************************//**
+	 * @brief
+	 *   Add the accelerometer to the C driver if it isn't on the default CS pin.
+	 *
+	 * @details
+	 *   The default device is registered by the C driver itself, it's only
+	 *   looked up (getDefaultDeviceADXL). Calling this again doesn't use
+	 *   another device slot or reset the shadow (initADXL_device ignores a
+	 *   device that's already added).
+	 *
+	 * @return
+	 *   @li true - The accelerometer can be used.
+	 *   @li false - There are already ADXL_MAX_DEVICES devices.
+	 *****************************************************************************/
+	static bool init (void)
+	{
+		if (isDefault()) return (true);
+
+		return (initADXL_device(&instance, CsPort, CsPin, nullptr, 0));
+	}
+
+
+	/**************************************************************************//**
+	 * @brief
+	 *   Get the device handle in the C driver (for selectADXL or drainADXL_devices).
+	 *****************************************************************************/
+	static ADXL_Device_TypeDef *device (void)
+	{
+		return (isDefault() ? getDefaultDeviceADXL() : &instance);
+	}
+
+
+	/**************************************************************************//**
+	 * @brief
+	 *   Write the range, ODR, bandwidth and mode in one burst (FILTER_CTL and POWER_CTL).
+	 *
+	 * @param[in] mode
+	 *   The measurement mode.
+	 *
+	 * @param[in] noise
+	 *   The noise mode.
+	 *****************************************************************************/
+	static void configure (Mode mode, Noise noise = Noise::Normal)
+	{
+		uint8_t regs[2] = { FILTER_CTL, powerCtl(mode, noise) };
+
+		transfer(ADXL_CMD_WRITE_REG, Reg::FILTER_CTL, regs, 2);
+	}
+
+
+	/**************************************************************************//**
+	 * @brief
+	 *   Write the activity threshold and time in one burst.
+	 *
+	 * @tparam Mg
+	 *   The threshold [mg] (checked at compile time for the range).
+	 *
+	 * @tparam Samples
+	 *   The activity time [samples].
+	 *****************************************************************************/
+	template <uint16_t Mg, uint8_t Samples = 0>
+	static void configureActivity (void)
+	{
+		static_assert(thresholdCodes(Mg) <= 0x7FF, "ADXL362 activity threshold doesn't fit in 11 bits for this range");
+
+		uint8_t regs[3] = { static_cast<uint8_t>(thresholdCodes(Mg) & 0xFF), static_cast<uint8_t>(thresholdCodes(Mg) >> 8), Samples };
+
+		transfer(ADXL_CMD_WRITE_REG, Reg::THRESH_ACT_L, regs, 3);
+	}
+
+
+	/**************************************************************************//**
+	 * @brief
+	 *   Write the inactivity threshold and time in one burst.
+	 *
+	 * @tparam Mg
+	 *   The threshold [mg] (checked at compile time for the range).
+	 *
+	 * @tparam Samples
+	 *   The inactivity time [samples].
+	 *****************************************************************************/
+	template <uint16_t Mg, uint16_t Samples>
+	static void configureInactivity (void)
+	{
+		static_assert(thresholdCodes(Mg) <= 0x7FF, "ADXL362 inactivity threshold doesn't fit in 11 bits for this range");
+
+		uint8_t regs[4] = { static_cast<uint8_t>(thresholdCodes(Mg) & 0xFF), static_cast<uint8_t>(thresholdCodes(Mg) >> 8),
+				static_cast<uint8_t>(Samples & 0xFF), static_cast<uint8_t>(Samples >> 8) };
+
+		transfer(ADXL_CMD_WRITE_REG, Reg::THRESH_INACT_L, regs, 4);
+	}
+
+
+	/**************************************************************************//**
+	 * @brief
+	 *   Read X-Y-Z in one burst and convert them to mg.
+	 *
+	 * @param[out] mg
+	 *   The X-Y-Z values [mg].
+	 *****************************************************************************/
+	static void readXYZ (int16_t mg[3])
+	{
+		uint8_t buffer[6];
+
+		transfer(ADXL_CMD_READ_REG, Reg::XDATA_L, buffer, 6);
+
+		mg[0] = toMg(static_cast<int16_t>((buffer[1] << 8) | buffer[0]));
+		mg[1] = toMg(static_cast<int16_t>((buffer[3] << 8) | buffer[2]));
+		mg[2] = toMg(static_cast<int16_t>((buffer[5] << 8) | buffer[4]));
+	}
+
+
+	/**************************************************************************//**
+	 * @brief
+	 *   Read one register.
+	 *****************************************************************************/
+	static uint8_t read (Reg reg)
+	{
+		uint8_t value;
+
+		transfer(ADXL_CMD_READ_REG, reg, &value, 1);
+
+		return (value);
+	}
+
+
+	/**************************************************************************//**
+	 * @brief
+	 *   Write one register (the shadow of the C driver is updated).
+	 *****************************************************************************/
+	static void write (Reg reg, uint8_t value)
+	{
+		transfer(ADXL_CMD_WRITE_REG, reg, &value, 1);
+	}
+
+
+private:
+	static ADXL_Device_TypeDef instance; /* Handle if it isn't on the default CS pin */
+
+	static constexpr bool isDefault (void)
+	{
+		return ((CsPort == ADXL_NCS_PORT) && (CsPin == ADXL_NCS_PIN));
+	}
+
+	/* Blocking transfer through the queue of the C driver (EM1 while waiting) */
+	static void transfer (uint8_t command, Reg reg, uint8_t *buffer, uint16_t length)
+	{
+		ADXL_Transaction_TypeDef transaction = { command, static_cast<uint8_t>(reg), buffer, length, nullptr, nullptr, true, device() };
+
+		while (!queueADXL(&transaction)) EMU_EnterEM1();
+
+		waitADXL(&transaction);
+	}
+};
+
+template <GPIO_Port_TypeDef CsPort, unsigned int CsPin, Range R, ODR O, bool HalfBW>
+ADXL_Device_TypeDef Driver<CsPort, CsPin, R, O, HalfBW>::instance;
+
+
+/* The accelerometer on the board with the boot configuration of "accel.h" */
+typedef Driver<ADXL_NCS_PORT, ADXL_NCS_PIN, static_cast<Range>(ADXL_CFG_RANGE), static_cast<ODR>(ADXL_CFG_ODR), (ADXL_CFG_HALF_BW != 0)> Board;
+
+} /* namespace adxl362 */
+
+
+#endif /* _ADXL362_HPP_ */
@@ -16,6 +16,10 @@
 #include "em_cmu.h"
 #include "em_gpio.h"
 #include "em_usart.h"
+#include "em_dma.h"
+#include "em_emu.h"
+#include "em_core.h"
+#include "em_msc.h"
 
 #include "../inc/util.h"     	/* Utility functions */
 #include "../inc/handlers.h" 	/* Interrupt handlers */
@@ -24,6 +28,32 @@
 #include "../inc/debugging.h" /* Enable or disable printing to UART */
 
 
+/* C linkage when included from C++ (ADXL362.hpp) */
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+
+/* ADXL SPI COMMANDS */
+#define ADXL_CMD_WRITE_REG 		0x0A /* Write register(s), address auto-increments */
+#define ADXL_CMD_READ_REG 		0x0B /* Read register(s), address auto-increments */
+#define ADXL_CMD_READ_FIFO 		0x0D /* Read FIFO entries (no address byte) */
+
+
+/* DMA channels used for the SPI transfers */
+#define ADXL_DMA_CH_RX 			0
+#define ADXL_DMA_CH_TX 			1
+#define ADXL_DMA_MAX_TRANSFERS 	1024 /* Maximum amount of transfers in one DMA cycle (n_minus_1 is 10 bits) */
+
+
+/* Maximum amount of transactions waiting for the SPI bus */
+#define ADXL_QUEUE_SIZE 		8
+
+
+/* Maximum amount of accelerometers on the SPI bus (including the default one) */
+#define ADXL_MAX_DEVICES 		3
+
+
 /* ADXL REGISTERS */
 #define ADXL_REG_DEVID_AD 		0x00 /* Reset: 0xAD */
 #define ADXL_REG_DEVID_MST 		0x01 /* Reset: 0x1D */
@@ -33,16 +63,374 @@
 #define ADXL_REG_YDATA 			0x09
 #define ADXL_REG_ZDATA 			0x0A
 #define ADXL_REG_STATUS 		0x0B
+#define ADXL_REG_FIFO_ENTRIES_L 0x0C /* 7:0 bits used */
+#define ADXL_REG_FIFO_ENTRIES_H 0x0D /* 1:0 bits used */
+#define ADXL_REG_XDATA_L 		0x0E /* 12-bit data: _L = 7:0 bits, _H = 4 sign extension bits + 11:8 bits */
+#define ADXL_REG_XDATA_H 		0x0F
+#define ADXL_REG_YDATA_L 		0x10
+#define ADXL_REG_YDATA_H 		0x11
+#define ADXL_REG_ZDATA_L 		0x12
+#define ADXL_REG_ZDATA_H 		0x13
 #define ADXL_REG_TEMP_L 		0x14
 #define ADXL_REG_TEMP_H 		0x15
 #define ADXL_REG_SOFT_RESET 	0x1F /* Needs to be 0x52 ("R") written to for a soft reset */
 #define ADXL_REG_THRESH_ACT_L	0x20 /* 7:0 bits used */
 #define ADXL_REG_THRESH_ACT_H	0x21 /* 2:0 bits used */
+#define ADXL_REG_TIME_ACT 		0x22
+#define ADXL_REG_THRESH_INACT_L	0x23 /* 7:0 bits used */
+#define ADXL_REG_THRESH_INACT_H	0x24 /* 2:0 bits used */
+#define ADXL_REG_TIME_INACT_L	0x25
+#define ADXL_REG_TIME_INACT_H	0x26
 #define ADXL_REG_ACT_INACT_CTL  0x27 /* Activity/Inactivity control register: XX - XX - LINKLOOP - LINKLOOP - INACT_REF - INACT_EN - ACT_REF - ACT_EN */
+#define ADXL_REG_FIFO_CONTROL 	0x28 /* XXXX - AH - FIFO_TEMP - FIFO_MODE - FIFO_MODE */
+#define ADXL_REG_FIFO_SAMPLES 	0x29 /* Watermark, bit 8 is the AH bit in FIFO_CONTROL. Reset: 0x80 */
 #define ADXL_REG_INTMAP1 		0x2A /* INT_LOW -- AWAKE -- INACT -- ACT -- FIFO_OVERRUN -- FIFO_WATERMARK -- FIFO_READY -- DATA_READY */
 #define ADXL_REG_INTMAP2 		0x2B /* INT_LOW -- AWAKE -- INACT -- ACT -- FIFO_OVERRUN -- FIFO_WATERMARK -- FIFO_READY -- DATA_READY */
 #define ADXL_REG_FILTER_CTL 	0x2C /* Write FFxx xxxx (FF = 00 for +-2g, 01 for =-4g, 1x for +- 8g) for measurement range selection */
 #define ADXL_REG_POWER_CTL 		0x2D /* Write xxxx xxMM (MM = 10) to: measurement mode */
+#define ADXL_REG_SELF_TEST 		0x2E /* Bit 0 enables the self test force */
+
+
+/* Shadowed (writable) registers: SOFT_RESET up to SELF_TEST */
+#define ADXL_SHADOW_FIRST 		ADXL_REG_SOFT_RESET
+#define ADXL_SHADOW_LAST 		ADXL_REG_SELF_TEST
+#define ADXL_SHADOW_SIZE 		(ADXL_SHADOW_LAST - ADXL_SHADOW_FIRST + 1)
+
+
+/* FIFO settings */
+#define ADXL_FIFO_DISABLED 		0b00
+#define ADXL_FIFO_OLDEST 		0b01 /* Oldest saved mode */
+#define ADXL_FIFO_STREAM 		0b10
+#define ADXL_FIFO_TRIGGERED 	0b11
+#define ADXL_FIFO_SIZE 			512 /* Entries (one entry = one axis) */
+#define ADXL_FIFO_SETS 			(ADXL_FIFO_SIZE / 3) /* X-Y-Z sample sets that fit in the FIFO */
+
+
+/* Activity/inactivity link modes (ACT_INACT_CTL bits 5:4) */
+#define ADXL_LINK_DEFAULT 		0b00 /* Detectors run independently, interrupts are acknowledged by reading STATUS */
+#define ADXL_LINK_LINKED 		0b01 /* Activity and inactivity detection alternate, interrupts are acknowledged by reading STATUS */
+#define ADXL_LINK_LOOP 			0b11 /* Activity and inactivity detection alternate, no acknowledge necessary */
+
+
+/* Synchronized sampling (INT2 driven by the MCU using RTC compare channel 1) */
+#define ADXL_SYNC_CLOCK 		32768 /* RTC frequency [Hz] (LFXO) */
+#define ADXL_SYNC_BLOCK 		128   /* X-Y-Z sets between FIFO drains */
+#define ADXL_SYNC_PULSE 		1     /* Minimum high time of the trigger on INT2 [RTC ticks] (30.5 us) */
+
+
+/* Automatic range switching ([codes], full scale is 2047 in every range) */
+#define ADXL_AUTORANGE_CLIP 	1900 /* A value at or above this switches to the next range immediately */
+#define ADXL_AUTORANGE_LOW 		800  /* All values below this ... */
+#define ADXL_AUTORANGE_CALM 	200  /* ... for this many sets switches to the previous range */
+
+
+/* Adaptive ODR controller (signal energy = mean absolute deviation of a batch [mg]) */
+#define ADXL_ODR_ENERGY_UP 		40 /* Above this: next ODR */
+#define ADXL_ODR_ENERGY_QUIET 	10 /* Below this: counts as quiet time */
+#define ADXL_ODR_LOG_SIZE 		16 /* Transitions kept in the log */
+
+/* Reasons for an ODR transition */
+#define ADXL_ODR_REASON_ENERGY 		0
+#define ADXL_ODR_REASON_ACTIVITY 	1
+#define ADXL_ODR_REASON_QUIET 		2
+
+
+/* Temperature sensor (typical values, 0.065 degrees C/LSB) */
+#define ADXL_TEMP_BIAS 			350 /* [LSB] at 25 degrees C */
+#define ADXL_TEMP_POINTS_MAX 	8   /* Maximum size of the offset-vs-temperature table */
+#define ADXL_TEMP_HYSTERESIS 	8   /* Change [LSB] before the offsets are recalculated (about 0.5 degrees C) */
+
+
+/* Self-test (done at +-8g and 100 Hz, limits of the output change in mg) */
+#define ADXL_ST_SETTLE 			40  /* Wait after changing the test force [ms] (4 / ODR) */
+#define ADXL_ST_SAMPLES 		8   /* Readings averaged with the test force off and on */
+#define ADXL_ST_BUDGET 			300 /* Maximum duration [ms] */
+#define ADXL_ST_X_MIN 			450
+#define ADXL_ST_X_MAX 			710
+#define ADXL_ST_Y_MIN 			-710
+#define ADXL_ST_Y_MAX 			-450
+#define ADXL_ST_Z_MIN 			350
+#define ADXL_ST_Z_MAX 			650
+
+
+/* Six-orientation calibration (stored in the user data page) */
+#define ADXL_CAL_MAGIC 			0xCA11
+#define ADXL_CAL_SAMPLES 		16   /* Readings averaged per orientation */
+#define ADXL_CAL_WAIT 			5000 /* Time to turn the board during calibrateADXL [ms] */
+
+/* Orientations, the axis pointing up (+) or down (-) */
+#define ADXL_CAL_X_UP 			0
+#define ADXL_CAL_X_DOWN 		1
+#define ADXL_CAL_Y_UP 			2
+#define ADXL_CAL_Y_DOWN 		3
+#define ADXL_CAL_Z_UP 			4
+#define ADXL_CAL_Z_DOWN 		5
+
+
+/* Results of checkHealthADXL */
+#define ADXL_HEALTH_OK 			0 /* ID correct, all registers match the shadow */
+#define ADXL_HEALTH_REPAIRED 	1 /* Corrupted registers were rewritten */
+#define ADXL_HEALTH_FAILED 		2 /* Wrong ID or the repair didn't work, a reset is necessary */
+#define ADXL_HEALTH_INTERVAL 	10 /* Time between two background health checks [s] (less than the RTC period) */
+
+
+/* Noise floor tuning of the activity/inactivity thresholds */
+#define ADXL_TUNE_MIN_SAMPLES 	8 /* Minimum amount of samples in the window */
+
+
+/* Time spent in every profile during testADXL [ms] */
+#define ADXL_PROFILE_DWELL 		2000
+
+
+/* Recovery state machine (waits in ms, timed with RTC compare channel 1) */
+#define ADXL_RESET_WAIT 		1   /* After a soft reset (datasheet: 0.5 ms) */
+#define ADXL_POWERUP_WAIT 		5   /* After enabling VCC (datasheet: 5 ms turn-on time) */
+#define ADXL_POWEROFF_WAIT 		10  /* VCC disabled, lets the supply decoupling discharge */
+#define ADXL_BACKOFF_MIN 		10  /* Wait after the first failed attempt, doubled after every next one */
+#define ADXL_RECOVERY_SOFT 		2   /* Attempts with only a soft reset, the next ones also power cycle */
+#define ADXL_RECOVERY_ATTEMPTS 	6   /* Attempts before giving up */
+
+/* DATA_READY acquisition: samples buffered in between reads by the main loop */
+#define ADXL_DRDY_BUFFER 		16
+
+
+/* Milliseconds to RTC ticks (rounded up) */
+#define ADXL_MS_TO_TICKS(ms) 	((((uint32_t)(ms) * ADXL_SYNC_CLOCK) + 999) / 1000)
+
+
+#ifdef ADXL_TRACE /* ADXL_TRACE */
+/* SPI transaction trace */
+#define ADXL_TRACE_SIZE 		32 /* Transactions kept in the ring buffer */
+#define ADXL_TRACE_CALLERS 		16 /* Callers with their own counters */
+#endif /* ADXL_TRACE */
+
+
+/* Fixed point format of the conversion multipliers */
+#define ADXL_CONV_Q 			12
+
+
+/* Boot configuration, written in one burst (THRESH_ACT_L up to POWER_CTL) by configADXL_boot */
+#define ADXL_CFG_RANGE 			1    /* 0 = +-2g -- 1 = +-4g -- 2 = +-8g */
+#define ADXL_CFG_ODR 			0    /* 0 = 12.5 Hz -- 3 = 100 Hz (reset default) -- 5 = 400 Hz */
+#define ADXL_CFG_HALF_BW 		1    /* 1 = bandwidth at ODR/4 (reset default) -- 0 = bandwidth at ODR/2 */
+#define ADXL_CFG_ACT_THRESH 	3000 /* Activity threshold [mg] */
+#define ADXL_CFG_ACT_TIME 		0    /* Activity time [samples] */
+#define ADXL_CFG_INACT_THRESH 	250  /* Inactivity threshold [mg] */
+#define ADXL_CFG_INACT_TIME 	25   /* Inactivity time [samples] */
+#define ADXL_CFG_ACT_INACT_CTL 	0b00111111 /* Loop mode, referenced activity and inactivity detection enabled */
+#define ADXL_CFG_FIFO_MODE 		ADXL_FIFO_STREAM
+#define ADXL_CFG_FIFO_WATERMARK 480  /* [entries] = 160 X-Y-Z sets */
+#define ADXL_CFG_INTMAP1 		0b00010000 /* Activity on INT1 */
+#define ADXL_CFG_INTMAP2 		0b00000100 /* FIFO watermark on INT2 */
+#define ADXL_CFG_POWER_CTL 		0b00000010 /* Measurement mode */
+
+/* Registers written by configADXL_boot */
+#define ADXL_BOOT_FIRST 		ADXL_REG_THRESH_ACT_L
+#define ADXL_BOOT_SIZE 			(ADXL_REG_POWER_CTL - ADXL_REG_THRESH_ACT_L + 1)
+
+/* Thresholds in "codes" (1 mg/LSB at +-2g, 2 mg/LSB at +-4g, 4 mg/LSB at +-8g) */
+#define ADXL_CFG_ACT_CODES 		(ADXL_CFG_ACT_THRESH >> ADXL_CFG_RANGE)
+#define ADXL_CFG_INACT_CODES 	(ADXL_CFG_INACT_THRESH >> ADXL_CFG_RANGE)
+
+#if (ADXL_CFG_ACT_CODES > 0x7FF) || (ADXL_CFG_INACT_CODES > 0x7FF)
+#error "ADXL threshold doesn't fit in 11 bits for the selected range"
+#endif
+
+
+/* One X-Y-Z sample set read from the FIFO (axis tags removed, sign extended) */
+typedef struct
+{
+	int16_t x;
+	int16_t y;
+	int16_t z;
+	uint8_t range; /* Range the set was measured in (0 = +-2g -- 1 = +-4g -- 2 = +-8g) */
+} ADXL_FifoSample_TypeDef;
+
+
+/* One full resolution X-Y-Z-temperature sample (12-bit values, sign extended) */
+typedef struct
+{
+	int16_t x;
+	int16_t y;
+	int16_t z;
+	int16_t temp;
+	uint8_t range; /* Range the sample was measured in */
+} ADXL_Sample_TypeDef;
+
+
+/* Counters of the DATA_READY acquisition */
+typedef struct
+{
+	uint32_t samples;    /* New samples read */
+	uint32_t missed;     /* Samples that were never read (RTC time in between two reads, only counted in measurement mode) */
+	uint32_t duplicates; /* Reads without new data (DATA_READY bit in STATUS was low) */
+	uint32_t overflows;  /* Samples dropped since the buffer was full */
+} ADXL_DataReady_TypeDef;
+
+
+/* Samples captured around an activity event (FIFO triggered mode) */
+typedef struct
+{
+	ADXL_FifoSample_TypeDef *samples; /* Buffer for the sample sets (set by the caller) */
+	uint16_t maxSets;                 /* Amount of sets that fit in the buffer (set by the caller) */
+	uint16_t sets;                    /* Amount of sets captured */
+	uint16_t preSets;                 /* The first preSets sets are from before the event */
+	uint32_t timestamp;               /* RTC counter value when the capture was started */
+} ADXL_Event_TypeDef;
+
+
+/* Power states of the accelerometer */
+typedef enum
+{
+	ADXL_STATE_STANDBY,   /* No measurements (~10 nA) */
+	ADXL_STATE_MEASURE,   /* Measurements at the configured ODR */
+	ADXL_STATE_WAKEUP,    /* Wake-up mode, about six measurements per second (~270 nA) */
+	ADXL_STATE_AUTOSLEEP  /* Measurement mode, switches to wake-up mode itself on inactivity (loop mode) */
+} ADXL_PowerState_TypeDef;
+
+
+/* Result of the self-test */
+typedef struct
+{
+	int16_t delta[3]; /* X-Y-Z output change [mg] */
+	uint32_t time;    /* Duration [ms] */
+	bool passed;      /* All deltas within the limits and within the time budget */
+} ADXL_SelfTest_TypeDef;
+
+
+/* Result of tuneADXL_thresholds */
+typedef struct
+{
+	uint16_t noise[3];       /* Noise floor (standard deviation) per axis [mg] */
+	uint16_t samples;        /* Samples measured during the window */
+	uint16_t actThreshold;   /* Activity threshold written [mg] */
+	uint16_t inactThreshold; /* Inactivity threshold written [mg] */
+} ADXL_NoiseFloor_TypeDef;
+
+
+/* Offset and gain calibration (size is a multiple of 4 bytes for MSC_WriteWord) */
+typedef struct
+{
+	uint16_t magic;    /* ADXL_CAL_MAGIC */
+	int16_t offset[3]; /* X-Y-Z zero-g offset [mg] */
+	int32_t gain[3];   /* X-Y-Z gain correction (1 << ADXL_CONV_Q = 1.0) */
+	uint16_t reserved;
+	uint16_t crc;      /* CRC16-CCITT of everything above */
+} ADXL_Calibration_TypeDef;
+
+
+/* Health counters (telemetry) */
+typedef struct
+{
+	uint32_t checks;       /* Amount of health checks */
+	uint16_t idErrors;     /* Checks with a wrong ID */
+	uint16_t errUserRegs;  /* Checks with the ERR_USER_REGS bit set in STATUS */
+	uint16_t mismatches;   /* Checks with at least one register different from the shadow */
+	uint16_t repaired;     /* Registers rewritten */
+	uint16_t failures;     /* Checks that returned ADXL_HEALTH_FAILED */
+} ADXL_Health_TypeDef;
+
+
+/* One point of the offset-vs-temperature table */
+typedef struct
+{
+	int16_t temp;      /* Raw temperature value [LSB] (the table is sorted on this) */
+	int16_t offset[3]; /* Zero-g offset of X-Y-Z at this temperature [mg] */
+} ADXL_TempPoint_TypeDef;
+
+
+/* One logged ODR transition of the adaptive ODR controller */
+typedef struct
+{
+	uint32_t timestamp; /* RTC counter value */
+	uint8_t from;       /* Previous ODR setting */
+	uint8_t to;         /* New ODR setting */
+	uint8_t reason;     /* ADXL_ODR_REASON_ENERGY, ADXL_ODR_REASON_ACTIVITY or ADXL_ODR_REASON_QUIET */
+} ADXL_ODRLog_TypeDef;
+
+
+/* Power/noise profiles (POWER_CTL LOW_NOISE + FILTER_CTL HALF_BW and ODR) */
+typedef enum
+{
+	ADXL_PROFILE_ULTRALOWPOWER, /* Normal operation, 12.5 Hz */
+	ADXL_PROFILE_NORMAL,        /* Normal operation, 100 Hz */
+	ADXL_PROFILE_LOWNOISE,      /* Low noise mode, 100 Hz */
+	ADXL_PROFILE_ULTRALOWNOISE, /* Ultralow noise mode, 100 Hz */
+	ADXL_PROFILES               /* Amount of profiles (also returned if the settings don't match a profile) */
+} ADXL_Profile_TypeDef;
+
+
+/* Register settings and expected figures of a profile (typical values, VS = 2.0 V, measurement mode) */
+typedef struct
+{
+	const char *name;
+	uint8_t lowNoise;   /* POWER_CTL bits 5:4 (0 = normal, 1 = low noise, 2 = ultralow noise) */
+	uint8_t halfBW;     /* FILTER_CTL bit 4 (1 = bandwidth at ODR/4) */
+	uint8_t odr;        /* FILTER_CTL bits 2:0 */
+	uint16_t current;   /* Supply current [nA] */
+	uint16_t noise;     /* RMS noise on X and Y [ug] (noise density * sqrt(bandwidth)) */
+} ADXL_ProfileInfo_TypeDef;
+
+
+/* States of the recovery state machine */
+typedef enum
+{
+	ADXL_RECOVERY_IDLE,      /* Not recovering (last recovery succeeded) */
+	ADXL_RECOVERY_POWER_OFF, /* VCC disabled, waiting */
+	ADXL_RECOVERY_POWER_UP,  /* VCC enabled, waiting for the turn-on time */
+	ADXL_RECOVERY_RESET,     /* Soft reset done, waiting before the ID check */
+	ADXL_RECOVERY_BACKOFF,   /* Attempt failed, waiting before the next one */
+	ADXL_RECOVERY_FAILED     /* Gave up after ADXL_RECOVERY_ATTEMPTS attempts */
+} ADXL_RecoveryState_TypeDef;
+
+
+#ifdef ADXL_TRACE /* ADXL_TRACE */
+/* One traced SPI transaction */
+typedef struct
+{
+	uint32_t timestamp; /* RTC counter value when the transaction was queued */
+	const char *caller; /* Name of the method that called the transport (__func__) */
+	uint8_t command;    /* ADXL_CMD_READ_REG, ADXL_CMD_WRITE_REG or ADXL_CMD_READ_FIFO */
+	uint8_t address;
+	uint16_t length;    /* Amount of data bytes */
+} ADXL_Trace_TypeDef;
+
+
+/* Traffic counters of one caller */
+typedef struct
+{
+	const char *caller;
+	uint32_t transactions;
+	uint32_t bytes;        /* Data bytes (without command and address) */
+} ADXL_TraceCaller_TypeDef;
+#endif /* ADXL_TRACE */
+
+
+/* SPI transaction for the queue (the descriptor needs to stay valid until "done" is set) */
+typedef struct ADXL_Transaction
+{
+	uint8_t command;  /* ADXL_CMD_READ_REG, ADXL_CMD_WRITE_REG or ADXL_CMD_READ_FIFO */
+	uint8_t address;  /* First register (not used for ADXL_CMD_READ_FIFO) */
+	uint8_t *buffer;  /* Data to write or location for the response */
+	uint16_t length;  /* Amount of data bytes */
+	void (*callback)(struct ADXL_Transaction *transaction); /* Called from the DMA interrupt handler when done (can be NULL) */
+	void *user;       /* Free to use by the caller */
+	volatile bool done;
+	struct ADXL_Device *device; /* Accelerometer to talk to, NULL = the selected one (selectADXL) */
+} ADXL_Transaction_TypeDef;
+
+
+/* One accelerometer on the shared SPI bus */
+typedef struct ADXL_Device
+{
+	GPIO_Port_TypeDef csPort;
+	unsigned int csPin;
+	uint8_t shadow[ADXL_SHADOW_SIZE]; /* RAM copy of the writable registers (SOFT_RESET up to SELF_TEST) */
+	uint8_t range;                    /* Range selected in the shadow */
+	ADXL_FifoSample_TypeDef *samples; /* Buffer for drainADXL_devices (set by the caller) */
+	uint16_t maxSets;                 /* Amount of sets that fit in the buffer (set by the caller) */
+	uint16_t sets;                    /* Amount of sets read by the last drainADXL_devices */
+} ADXL_Device_TypeDef;
 
 
 /* Prototypes */
@@ -51,25 +439,139 @@ void powerADXL (bool enabled);
 
 void enableSPIpinsADXL (bool enabled);
 void initADXL_SPI (void);
+void initADXL_DMA (void);
 
 void testADXL (void);
 
 void readValuesADXL (void);
+bool selfTestADXL (ADXL_SelfTest_TypeDef *result);
 void resetHandlerADXL (void);
+void startADXL_recovery (void);
+ADXL_RecoveryState_TypeDef recoveryStepADXL (void);
+bool recoveryBusyADXL (void);
+bool poweredADXL (void);
+
+void powerDownADXL_gated (void);
+uint32_t powerUpADXL_restore (void);
+bool gatedADXL (void);
+
+#ifdef ADXL_TRACE /* ADXL_TRACE */
+/* The transport methods get the name of the calling method to tag the transactions with */
+uint8_t readADXL_traced (uint8_t address, const char *caller);
+void writeADXL_traced (uint8_t address, uint8_t data, const char *caller);
+void burstReadADXL_traced (uint8_t address, uint8_t *buffer, uint16_t length, const char *caller);
+void burstWriteADXL_traced (uint8_t address, const uint8_t *buffer, uint16_t length, const char *caller);
+bool queueADXL_traced (ADXL_Transaction_TypeDef *transaction, const char *caller);
+void updateADXL_traced (uint8_t address, uint8_t mask, uint8_t bits, const char *caller);
 
+#define readADXL(address) 						readADXL_traced((address), __func__)
+#define writeADXL(address, data) 				writeADXL_traced((address), (data), __func__)
+#define burstReadADXL(address, buffer, length) 	burstReadADXL_traced((address), (buffer), (length), __func__)
+#define burstWriteADXL(address, buffer, length) burstWriteADXL_traced((address), (buffer), (length), __func__)
+#define queueADXL(transaction) 					queueADXL_traced((transaction), __func__)
+#define updateADXL(address, mask, bits) 		updateADXL_traced((address), (mask), (bits), __func__)
+#else
 uint8_t readADXL (uint8_t address);
 void writeADXL (uint8_t address, uint8_t data);
+void burstReadADXL (uint8_t address, uint8_t *buffer, uint16_t length);
+void burstWriteADXL (uint8_t address, const uint8_t *buffer, uint16_t length);
+#endif /* ADXL_TRACE */
+
+#ifdef ADXL_TRACE /* ADXL_TRACE */
+void dumpADXL_trace (void);
+void clearADXL_trace (void);
+#endif /* ADXL_TRACE */
+
+bool initADXL_device (ADXL_Device_TypeDef *device, GPIO_Port_TypeDef csPort, unsigned int csPin,
+		ADXL_FifoSample_TypeDef *samples, uint16_t maxSets);
+void selectADXL (ADXL_Device_TypeDef *device);
+ADXL_Device_TypeDef *getDeviceADXL (void);
+ADXL_Device_TypeDef *getDefaultDeviceADXL (void);
+void drainADXL_devices (ADXL_Device_TypeDef *const *devices, uint8_t count);
+
+#ifndef ADXL_TRACE /* ADXL_TRACE */
+bool queueADXL (ADXL_Transaction_TypeDef *transaction);
+#endif /* ADXL_TRACE */
+bool queueBusyADXL (void);
+void waitADXL (ADXL_Transaction_TypeDef *transaction);
+void waitQueueADXL (void);
 void readADXL_XYZDATA (void);
+void readADXL_XYZTDATA (ADXL_Sample_TypeDef *sample);
+void configADXL_tempComp (const ADXL_TempPoint_TypeDef *table, uint8_t points);
+int16_t convertADXL_temp (int16_t raw);
+
+void configADXL_FIFO (uint8_t mode, uint16_t watermark);
+uint16_t readADXL_FIFOentries (void);
+uint16_t readADXL_FIFO (ADXL_FifoSample_TypeDef *samples, uint16_t maxSamples);
+
+void configADXL_capture (uint16_t preSets, uint16_t postSets);
+bool captureArmedADXL (void);
+bool captureADXL_event (ADXL_Event_TypeDef *event);
+
+void configADXL_sync (uint16_t rate);
+void stopADXL_sync (void);
+void configADXL_dataReady (bool enabled);
+bool dataReadyADXL (void);
+bool dataReadyEnabledADXL (void);
+uint8_t readADXL_dataReady (ADXL_Sample_TypeDef *samples, uint8_t maxSamples);
+void getDataReadyADXL (ADXL_DataReady_TypeDef *stats);
+bool triggerADXL_sync (void);
+uint16_t readADXL_sync (ADXL_FifoSample_TypeDef *samples, uint16_t maxSamples, uint32_t *timestamp);
+uint32_t getSyncPeriodADXL (void);
+
+#ifndef ADXL_TRACE /* ADXL_TRACE */
+void updateADXL (uint8_t address, uint8_t mask, uint8_t bits);
+#endif /* ADXL_TRACE */
+uint8_t getShadowADXL (uint8_t address);
+void resyncADXL (void);
+bool verifyADXL (void);
+uint8_t checkHealthADXL (void);
+bool healthDueADXL (void);
+void getHealthADXL (ADXL_Health_TypeDef *counters);
 
 void measureADXL (bool enabled);
+void setProfileADXL (ADXL_Profile_TypeDef profile);
+ADXL_Profile_TypeDef getProfileADXL (void);
+const ADXL_ProfileInfo_TypeDef *getProfileInfoADXL (ADXL_Profile_TypeDef profile);
+void setPowerStateADXL (ADXL_PowerState_TypeDef state);
+ADXL_PowerState_TypeDef getPowerStateADXL (void);
+void setPowerHookADXL (void (*hook)(ADXL_PowerState_TypeDef state));
+bool awakeADXL (void);
+void configADXL_adaptiveODR (uint16_t bandwidth, uint16_t quietTime);
+void adaptADXL_ODR (const ADXL_FifoSample_TypeDef *samples, uint16_t sets);
+void activityADXL_ODR (void);
+uint8_t getODRlogADXL (ADXL_ODRLog_TypeDef *log, uint8_t maxEntries);
 void configADXL_range (uint8_t givenRange);
+void configADXL_autoRange (bool enabled);
+void autoRangeADXL (const ADXL_FifoSample_TypeDef *samples, uint16_t sets);
 void configADXL_ODR (uint8_t givenODR);
 void configADXL_activity (uint8_t gThreshold);
+void configADXL_activity_mg (uint16_t mgThreshold);
+bool tuneADXL_thresholds (uint8_t actFactor, uint8_t inactFactor, uint16_t window, ADXL_NoiseFloor_TypeDef *result);
+void configADXL_activityTime (uint8_t time);
+void configADXL_inactivity (uint16_t mgThreshold, uint16_t time);
+void configADXL_link (uint8_t mode);
+void acknowledgeADXL (void);
+void configADXL_boot (void);
 
 void softResetADXL (void);
 bool checkID_ADXL (void);
 
 int32_t convertGRangeToGValue (int8_t sensorValue);
+void convertADXL_mg8 (const int8_t *raw, int16_t *mg, uint16_t sets);
+void convertADXL_mg12 (const int16_t *raw, int16_t *mg, uint16_t sets);
+void calibrateADXL (void);
+void calibrateADXL_orientation (uint8_t orientation);
+bool calibrateADXL_finish (void);
+bool loadADXL_calibration (void);
+bool saveADXL_calibration (const ADXL_Calibration_TypeDef *cal);
+void convertADXL_sets (const ADXL_FifoSample_TypeDef *samples, int16_t *mg, uint16_t sets);
+void benchmarkConvertADXL (void);
+
+
+#ifdef __cplusplus
+}
+#endif
 
 
 #endif /* _ACCEL_H_ */
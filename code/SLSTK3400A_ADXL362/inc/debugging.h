@@ -19,8 +19,18 @@
 #define DEBUGGING /* Comment to remove all USART1 stuff */
 
 
+/* Uncomment the line below to trace the SPI transactions to the accelerometer (dumping the trace needs DEBUGGING) */
+//#define ADXL_TRACE
+
+
 #ifdef DEBUGGING /* DEBUGGING */
+#ifdef __cplusplus
+extern "C" {
+#endif
 #include "dbprint.h"
+#ifdef __cplusplus
+}
+#endif
 #endif /* DEBUGGING */
 
 
@@ -17,11 +17,26 @@
 #include "em_gpio.h"   /* General Purpose IO */
 #include "em_rtc.h"    /* Real Time Counter (RTC) */
 
+#include "../inc/accel.h"     /* Functions related to the accelerometer */
 #include "../inc/debugging.h" /* Enable or disable printing to UART */
 
 
+/* C linkage when included from C++ (ADXL362.hpp) */
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+
 /* Global variables (project-wide accessible) */
-extern volatile bool triggered; /* Accelerometer triggered interrupt */
+extern volatile bool triggered;     /* Accelerometer triggered interrupt */
+extern volatile bool fifoWatermark; /* Accelerometer FIFO watermark interrupt */
+extern volatile bool syncDrain;     /* Synchronized sampling: FIFO block ready */
+extern volatile bool adxlRecovery;  /* Next step of the accelerometer recovery */
+
+
+#ifdef __cplusplus
+}
+#endif
 
 
 #endif /* _HANDLERS_H_ */
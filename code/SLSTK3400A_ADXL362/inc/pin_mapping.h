@@ -21,9 +21,17 @@
 #define ADXL_NCS_PORT  gpioPortD 	/* Can't use the US0_CS port (PE13) to manually set/clear CS line */
 #define ADXL_NCS_PIN   4
 
+/* CS of extra accelerometers on the same SPI bus (expansion header) */
+#define ADXL2_NCS_PORT gpioPortC
+#define ADXL2_NCS_PIN  1
+#define ADXL3_NCS_PORT gpioPortA
+#define ADXL3_NCS_PIN  0
+
 /* Other ADXL GPOI */
 #define ADXL_INT1_PORT gpioPortD
 #define ADXL_INT1_PIN  7
+#define ADXL_INT2_PORT gpioPortD
+#define ADXL_INT2_PIN  6
 #define ADXL_VCC_PORT  gpioPortD
 #define ADXL_VCC_PIN   5
 
@@ -20,6 +20,16 @@
 #include "../inc/debugging.h" 	/* Enable or disable printing to UART */
 
 
+/* C linkage when included from C++ (ADXL362.hpp) */
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+
+/* Global variables */
+extern volatile uint32_t msTicks; /* Milliseconds since SysTick was started (only counts when SysTick interrupts are enabled) */
+
+
 /* Prototypes */
 void initLEDS (void);
 void led0 (bool enabled);
@@ -28,4 +38,9 @@ void Delay (uint32_t dlyTicks);
 void systickInterrupts (bool enabled);
 
 
+#ifdef __cplusplus
+}
+#endif
+
+
 #endif /* _UTIL_H_ */
@@ -10,11 +10,222 @@
 #include "../inc/accel.h"
 
 
+/* Name of the method that called the transport method, traced as the caller of its transactions (NULL without the trace) */
+#ifdef ADXL_TRACE /* ADXL_TRACE */
+#define ADXL_CALLER 	caller
+#else
+#define ADXL_CALLER 	NULL
+#endif /* ADXL_TRACE */
+
+
 /* Global variables */
 volatile int8_t XYZDATA[3] = { 0x00, 0x00, 0x00 };
 uint8_t range = 0;
 
 
+/* Scale factors for 12-bit values [mg/LSB, Q12] (+-2g - +-4g - +-8g) */
+static const int32_t mgPerLSB[3] = { (1 << ADXL_CONV_Q), (2 << ADXL_CONV_Q), (4 << ADXL_CONV_Q) };
+
+
+/* Register values after a (soft) reset, SOFT_RESET up to SELF_TEST (one list for the table and the default shadow) */
+#define ADXL_RESET_VALUES { \
+	0x00, /* SOFT_RESET */ \
+	0x00, 0x00, 0x00, /* THRESH_ACT_L/H - TIME_ACT */ \
+	0x00, 0x00, 0x00, 0x00, /* THRESH_INACT_L/H - TIME_INACT_L/H */ \
+	0x00, 0x00, 0x80, /* ACT_INACT_CTL - FIFO_CONTROL - FIFO_SAMPLES */ \
+	0x00, 0x00, 0x13, 0x00, /* INTMAP1 - INTMAP2 - FILTER_CTL - POWER_CTL */ \
+	0x00 /* SELF_TEST */ \
+}
+
+static const uint8_t resetValuesADXL[ADXL_SHADOW_SIZE] = ADXL_RESET_VALUES;
+
+/* The accelerometer on the default CS pin, its shadow (RAM copy of the writable registers) is kept coherent by every write */
+static ADXL_Device_TypeDef defaultDevice = {
+	ADXL_NCS_PORT, ADXL_NCS_PIN,
+	ADXL_RESET_VALUES,
+	0, NULL, 0, 0
+};
+
+/* All accelerometers on the bus and the one the methods talk to */
+static ADXL_Device_TypeDef *devicesADXL[ADXL_MAX_DEVICES] = { &defaultDevice };
+static uint8_t deviceCount = 1;
+static ADXL_Device_TypeDef *activeDevice = &defaultDevice;
+
+
+/* Boot configuration image (THRESH_ACT_L up to POWER_CTL), see the ADXL_CFG_ settings in "accel.h" */
+static const uint8_t bootConfigADXL[ADXL_BOOT_SIZE] = {
+	(ADXL_CFG_ACT_CODES & 0xFF), ((ADXL_CFG_ACT_CODES >> 8) & 0x07), /* THRESH_ACT_L/H */
+	ADXL_CFG_ACT_TIME, /* TIME_ACT */
+	(ADXL_CFG_INACT_CODES & 0xFF), ((ADXL_CFG_INACT_CODES >> 8) & 0x07), /* THRESH_INACT_L/H */
+	(ADXL_CFG_INACT_TIME & 0xFF), ((ADXL_CFG_INACT_TIME >> 8) & 0xFF), /* TIME_INACT_L/H */
+	ADXL_CFG_ACT_INACT_CTL, /* ACT_INACT_CTL */
+	(((ADXL_CFG_FIFO_WATERMARK & 0x100) >> 5) | ADXL_CFG_FIFO_MODE), /* FIFO_CONTROL */
+	(ADXL_CFG_FIFO_WATERMARK & 0xFF), /* FIFO_SAMPLES */
+	ADXL_CFG_INTMAP1, /* INTMAP1 */
+	ADXL_CFG_INTMAP2, /* INTMAP2 */
+	((ADXL_CFG_RANGE << 6) | (ADXL_CFG_HALF_BW << 4) | ADXL_CFG_ODR), /* FILTER_CTL */
+	ADXL_CFG_POWER_CTL /* POWER_CTL (written last, as recommended by the datasheet) */
+};
+
+
+/* Power/noise profiles, figures from the datasheet (noise density 550, 400 and 175 ug/sqrt(Hz)) */
+static const ADXL_ProfileInfo_TypeDef profilesADXL[ADXL_PROFILES] = {
+	{ "ultra-low-power", 0, 1, 0,  1600, 970 }, /* Bandwidth 3.125 Hz */
+	{ "normal",          0, 1, 3,  1800, 2750 }, /* Bandwidth 25 Hz */
+	{ "low-noise",       1, 1, 3,  3300, 2000 },
+	{ "ultralow-noise",  2, 1, 3, 13000, 875 }
+};
+
+
+/* Calibration that is applied in the conversions (no correction by default) */
+static ADXL_Calibration_TypeDef calADXL = {
+	ADXL_CAL_MAGIC, { 0, 0, 0 }, { (1 << ADXL_CONV_Q), (1 << ADXL_CONV_Q), (1 << ADXL_CONV_Q) }, 0, 0
+};
+static int16_t calMeasured[6]; /* Axis value [mg] in every orientation during calibration */
+
+
+/* Local variables for the DMA-driven SPI transfers */
+static DMA_DESCRIPTOR_TypeDef dmaControlBlock[DMA_CHAN_COUNT * 2] __attribute__ ((aligned(256)));
+static DMA_CB_TypeDef dmaCallback;
+
+static uint8_t *dmaBuffer;            /* Next byte to be received or transmitted */
+static uint16_t dmaRemaining;         /* Bytes still to be transferred after the current DMA cycle */
+static bool dmaRead;                  /* true = fill dmaBuffer, false = send dmaBuffer */
+
+static const uint8_t dmaDummyTX = 0x00; /* Clocked out during reads */
+static uint8_t dmaDummyRX;              /* Sink for the bytes received during writes */
+
+
+/* Local variables for the event capture (FIFO triggered mode) */
+static uint16_t capturePre = 0;  /* Sets before the event */
+static uint16_t capturePost = 0; /* Sets after the event, 0 = capture disabled */
+
+
+/* Local variables for the automatic range switching */
+static bool autoRange = false;
+static uint16_t autoRangeCalm = 0; /* Consecutive sets below ADXL_AUTORANGE_LOW */
+static bool autoRangeClip = false; /* Clip seen while the switch was blocked */
+static uint16_t oldRangeSets = 0;  /* Sets in the FIFO that were measured before the last switch */
+static uint8_t oldRange = 0;
+
+
+/* Health counters */
+static ADXL_Health_TypeDef health = { 0, 0, 0, 0, 0, 0 };
+static bool healthStarted = false; /* False until the first healthDueADXL call */
+static uint32_t healthLast;        /* RTC counter value of the last due check */
+
+
+/* Local variables for the adaptive ODR controller */
+static uint8_t odrMax = 0xFF;      /* Highest ODR setting the controller uses, 0xFF = disabled */
+static uint16_t odrQuietTime;      /* Quiet time before dropping to 12.5 Hz [ms] */
+static uint32_t odrQuiet = 0;      /* Quiet time so far [ms] */
+static ADXL_ODRLog_TypeDef odrLog[ADXL_ODR_LOG_SIZE];
+static uint8_t odrLogNext = 0;
+static uint8_t odrLogCount = 0;
+
+
+/* Local variables for the temperature compensation */
+static const ADXL_TempPoint_TypeDef *tempTable = NULL; /* NULL = disabled */
+static uint8_t tempPoints = 0;
+static int16_t tempCached = INT16_MIN;       /* Temperature the offsets below belong to */
+static int16_t tempOffset[3] = { 0, 0, 0 };  /* Interpolated X-Y-Z offsets [mg] */
+
+
+/* Local variables for the synchronized sampling */
+static uint32_t syncPeriod = 0;           /* Trigger period [RTC ticks], 0 = disabled */
+static volatile uint32_t syncTriggers;    /* Triggers sent since the start */
+static uint32_t syncStart;                /* RTC counter value of the first trigger */
+static uint32_t syncNext;                 /* RTC counter value of the next set to be read */
+static uint8_t savedFilterCtl, savedIntmap2;
+
+
+/* Local variables for the DATA_READY acquisition */
+static volatile bool drdyEnabled = false;
+static uint8_t drdySavedIntmap2;
+static uint8_t drdyBuffer[11];               /* STATUS, FIFO_ENTRIES_L/H, X-Y-Z-TEMP (burst from 0x0B) */
+static ADXL_Transaction_TypeDef drdyRead;
+static uint32_t drdyEdge, drdyLast;          /* RTC counter values of the edge being read and of the last new sample */
+static bool drdyMeasuring;                   /* The last new sample was taken in measurement mode (at the ODR) */
+static ADXL_Sample_TypeDef drdySamples[ADXL_DRDY_BUFFER];
+static volatile uint8_t drdyHead = 0;
+static volatile uint8_t drdyCount = 0;
+static ADXL_DataReady_TypeDef drdyStats;
+
+
+/* Local variables for the power state machine */
+static void (*powerHook)(ADXL_PowerState_TypeDef state) = NULL;
+static uint8_t savedActInactCtl = 0x00; /* ACT_INACT_CTL before entering autosleep */
+
+
+/* Local variables for the recovery state machine */
+static volatile ADXL_RecoveryState_TypeDef recoveryState = ADXL_RECOVERY_IDLE;
+static uint8_t recoveryAttempt = 0;
+static uint32_t recoveryStart;                     /* RTC counter value at the start */
+static uint8_t recoveryImage[ADXL_SHADOW_SIZE];    /* Shadow before the recovery */
+
+
+/* Local variables for the power gating (VCC off in between sparse bursts) */
+static volatile bool gated = false;
+static uint8_t gateImage[ADXL_MAX_DEVICES][ADXL_SHADOW_SIZE]; /* Shadows before VCC was disabled */
+static ADXL_Transaction_TypeDef gateRestore[ADXL_MAX_DEVICES];
+
+
+/* Local variables for acknowledging interrupts */
+static uint8_t ackStatus;
+static ADXL_Transaction_TypeDef ackRead = { ADXL_CMD_READ_REG, ADXL_REG_STATUS, &ackStatus, 1, NULL, NULL, true, NULL };
+
+
+/* Local variables for the transaction queue (first one is the one on the bus) */
+static ADXL_Transaction_TypeDef *queue[ADXL_QUEUE_SIZE];
+static ADXL_Device_TypeDef *queueDevice[ADXL_QUEUE_SIZE]; /* Device of every queued transaction */
+static volatile uint8_t queueHead = 0;
+static volatile uint8_t queueCount = 0;
+
+
+#ifdef ADXL_TRACE /* ADXL_TRACE */
+/* Local variables for the SPI transaction trace */
+static ADXL_Trace_TypeDef trace[ADXL_TRACE_SIZE];
+static uint16_t traceNext = 0;
+static uint32_t traceCount = 0;  /* Transactions traced since the last clear */
+static ADXL_TraceCaller_TypeDef traceCallers[ADXL_TRACE_CALLERS];
+static uint32_t traceOther = 0;  /* Transactions of callers that didn't fit in traceCallers */
+#endif /* ADXL_TRACE */
+
+
+/* Local variables for draining the FIFOs of all accelerometers */
+static uint8_t drainEntries[ADXL_MAX_DEVICES][2];
+static ADXL_Transaction_TypeDef drainCount[ADXL_MAX_DEVICES];
+static ADXL_Transaction_TypeDef drainFifo[ADXL_MAX_DEVICES];
+static volatile bool drainQueued[ADXL_MAX_DEVICES];
+
+
+/* Local prototypes */
+static void startTransactionADXL (ADXL_Transaction_TypeDef *transaction, ADXL_Device_TypeDef *device);
+static void startDMA_ADXL (void);
+static void transferDoneADXL (unsigned int channel, bool primary, void *user);
+static void transferADXL (uint8_t command, uint8_t address, uint8_t *buffer, uint16_t length, const char *caller);
+static bool enqueueADXL (ADXL_Transaction_TypeDef *transaction, const char *caller);
+static void updateShadowADXL (ADXL_Device_TypeDef *device, uint8_t address, const uint8_t *buffer, uint16_t length);
+static void resetShadowADXL (ADXL_Device_TypeDef *device);
+static uint16_t decodeFifoADXL (ADXL_FifoSample_TypeDef *samples, uint16_t sets, const ADXL_Device_TypeDef *device);
+static void drainEntriesDoneADXL (ADXL_Transaction_TypeDef *transaction);
+static void dataReadyDoneADXL (ADXL_Transaction_TypeDef *transaction);
+static bool switchRangeADXL (uint8_t newRange);
+static void switchODR_ADXL (uint8_t odr, uint8_t reason);
+static void updateTempOffsetADXL (int16_t temp);
+static void calFactorsADXL (int32_t lsb, int32_t *mul, int32_t *add);
+static void startAttemptADXL (void);
+static void scheduleWakeupADXL (uint32_t ticks);
+static void sleepADXL_ticks (uint32_t ticks);
+static uint16_t crc16ADXL (const uint8_t *data, uint16_t length);
+static uint32_t ticksSinceADXL (uint32_t start);
+static uint16_t isqrtADXL (uint32_t value);
+
+#ifdef ADXL_TRACE /* ADXL_TRACE */
+static void traceADXL (const ADXL_Transaction_TypeDef *transaction, const char *caller);
+#endif /* ADXL_TRACE */
+
+
 /**************************************************************************//**
  * @brief
  *   Initialize the GPIO pin to supply the accelerometer with power.
@@ -24,6 +235,9 @@ void initADXL_VCC (void)
 	GPIO_PinModeSet(ADXL_VCC_PORT, ADXL_VCC_PIN, gpioModePushPull, 1);
 	GPIO_PinOutSet(ADXL_VCC_PORT, ADXL_VCC_PIN);   /* Enable VCC pin */
 
+	/* Registers are at their reset values after power-up (all accelerometers share VCC) */
+	for (uint8_t i = 0; i < deviceCount; i++) resetShadowADXL(devicesADXL[i]);
+
 #ifdef DEBUGGING /* DEBUGGING */
 	dbinfo("Accelerometer powered");
 #endif /* DEBUGGING */
@@ -44,6 +258,9 @@ void powerADXL (bool enabled)
 	{
 		GPIO_PinOutSet(ADXL_VCC_PORT, ADXL_VCC_PIN); /* Enable VCC pin */
 
+		/* Registers are at their reset values after power-up (all accelerometers share VCC) */
+		for (uint8_t i = 0; i < deviceCount; i++) resetShadowADXL(devicesADXL[i]);
+
 #ifdef DEBUGGING /* DEBUGGING */
 		dbinfo("Accelerometer powered");
 #endif /* DEBUGGING */
@@ -74,16 +291,19 @@ void enableSPIpinsADXL (bool enabled)
 	if (enabled)
 	{
 		GPIO_PinModeSet(ADXL_CLK_PORT, ADXL_CLK_PIN, gpioModePushPull, 0);   /* US0_CLK is push pull */
-		GPIO_PinModeSet(ADXL_NCS_PORT, ADXL_NCS_PIN, gpioModePushPull, 1);   /* US0_CS is push pull */
 		GPIO_PinModeSet(ADXL_MOSI_PORT, ADXL_MOSI_PIN, gpioModePushPull, 1); /* US0_TX (MOSI) is push pull */
 		GPIO_PinModeSet(ADXL_MISO_PORT, ADXL_MISO_PIN, gpioModeInput, 1);    /* US0_RX (MISO) is input */
+
+		/* CS of every accelerometer is push pull */
+		for (uint8_t i = 0; i < deviceCount; i++) GPIO_PinModeSet(devicesADXL[i]->csPort, devicesADXL[i]->csPin, gpioModePushPull, 1);
 	}
 	else
 	{
 		GPIO_PinModeSet(ADXL_CLK_PORT, ADXL_CLK_PIN, gpioModeDisabled, 0);
-		GPIO_PinModeSet(ADXL_NCS_PORT, ADXL_NCS_PIN, gpioModeDisabled, 1);
 		GPIO_PinModeSet(ADXL_MOSI_PORT, ADXL_MOSI_PIN, gpioModeDisabled, 1);
 		GPIO_PinModeSet(ADXL_MISO_PORT, ADXL_MISO_PIN, gpioModeDisabled, 1);
+
+		for (uint8_t i = 0; i < deviceCount; i++) GPIO_PinModeSet(devicesADXL[i]->csPort, devicesADXL[i]->csPin, gpioModeDisabled, 1);
 	}
 }
 
@@ -136,6 +356,9 @@ void initADXL_SPI (void)
 	/* Set CS high (active low!) */
 	GPIO_PinOutSet(gpioPortE, 13);
 
+	/* Let the DMA handle the data bytes of each transfer */
+	initADXL_DMA();
+
 #ifdef DEBUGGING /* DEBUGGING */
 	dbinfo("Accelerometer SPI initialized");
 #endif /* DEBUGGING */
@@ -145,8 +368,63 @@ void initADXL_SPI (void)
 
 /**************************************************************************//**
  * @brief
- *   Go through all of the register settings to see the influence
+ *   Initialize the DMA channels used for the SPI transfers to the accelerometer.
+ *
+ * @details
+ *   One channel moves received bytes out of USART0 (RXDATAV request),
+ *   the other one feeds USART0 (TXBL request). Only the RX channel
+ *   generates an interrupt, since the last byte is received after
+ *   the last byte is transmitted. The descriptors themselves are
+ *   (re)configured at the start of every transfer.
+ *****************************************************************************/
+void initADXL_DMA (void)
+{
+	/* Enable necessary clock */
+	CMU_ClockEnable(cmuClock_DMA, true);
+
+	/* Initialize the DMA controller */
+	DMA_Init_TypeDef dmaInit;
+	dmaInit.hprot = 0;
+	dmaInit.controlBlock = dmaControlBlock;
+	DMA_Init(&dmaInit);
+
+	/* Callback called from the DMA interrupt handler (located in "em_dma.c") */
+	dmaCallback.cbFunc = transferDoneADXL;
+	dmaCallback.userPtr = NULL;
+
+	/* RX channel: generates the completion interrupt */
+	DMA_CfgChannel_TypeDef rxChannel;
+	rxChannel.highPri = true; /* Make sure no received byte gets overwritten */
+	rxChannel.enableInt = true;
+	rxChannel.select = DMAREQ_USART0_RXDATAV;
+	rxChannel.cb = &dmaCallback;
+	DMA_CfgChannel(ADXL_DMA_CH_RX, &rxChannel);
+
+	/* TX channel: no interrupt necessary */
+	DMA_CfgChannel_TypeDef txChannel;
+	txChannel.highPri = false;
+	txChannel.enableInt = false;
+	txChannel.select = DMAREQ_USART0_TXBL;
+	txChannel.cb = NULL;
+	DMA_CfgChannel(ADXL_DMA_CH_TX, &txChannel);
+
+#ifdef DEBUGGING /* DEBUGGING */
+	dbinfo("Accelerometer DMA initialized");
+#endif /* DEBUGGING */
+
+}
+
+
+/**************************************************************************//**
+ * @brief
+ *   Go through all of the power/noise profiles to see the influence
  *   they have on power usage.
+ *
+ * @details
+ *   The sweep starts in standby, every profile is then kept for
+ *   ADXL_PROFILE_DWELL ms. A short LED0 pulse marks the start of every
+ *   step so it's visible on the current trace (Energy Profiler), the
+ *   msTicks value of every marker is also printed.
  *****************************************************************************/
 void testADXL (void)
 {
@@ -159,54 +437,51 @@ void testADXL (void)
 
 #ifdef DEBUGGING /* DEBUGGING */
 	dbwarn("Starting...");
-#endif /* DEBUGGING */
-
-#ifdef DEBUGGING /* DEBUGGING */
-	dbinfo("Testing the ADXL (all in +-2g default measurement range, 7 seconds):");
-	dbprintln("   standby - 1sec - ODR 12,5Hz + enable measurements - 1sec - ODR 25 Hz");
-	dbprintln("   - 1sec - ODR 50 Hz - 1sec - ODR 100 Hz (default on reset) - 1sec -");
-	dbprintln("   200Hz - 1sec - ODR 400 Hz - 1sec - soft Reset");
+	dbinfoInt("Testing the ADXL (standby + ", ADXL_PROFILES, " profiles):");
 #endif /* DEBUGGING */
 
 	/* Soft reset ADXL */
 	softResetADXL();
 
 	/* Standby */
-	Delay(1000);
+	led0(true);
+	Delay(1);
+	led0(false);
 
-	/* ODR 12,5Hz */
-	writeADXL(ADXL_REG_FILTER_CTL, 0b00010000); /* last 3 bits are ODR */
-
-	/* Enable measurements */
-	writeADXL(ADXL_REG_POWER_CTL, 0b00000010); /* last 2 bits are measurement mode */
+#ifdef DEBUGGING /* DEBUGGING */
+	dbinfoInt("[", msTicks, " ms] standby");
+#endif /* DEBUGGING */
 
-	Delay(1000);
+	Delay(ADXL_PROFILE_DWELL);
 
-	/* ODR 25Hz */
-	writeADXL(ADXL_REG_FILTER_CTL, 0b00010001); /* last 3 bits are ODR */
-	Delay(1000);
+	/* Enable measurements */
+	measureADXL(true);
 
-	/* ODR 50Hz */
-	writeADXL(ADXL_REG_FILTER_CTL, 0b00010010); /* last 3 bits are ODR */
-	Delay(1000);
+	for (uint8_t i = 0; i < ADXL_PROFILES; i++)
+	{
+		setProfileADXL((ADXL_Profile_TypeDef) i);
+		waitQueueADXL();
 
-	/* ODR 100Hz (default) */
-	writeADXL(ADXL_REG_FILTER_CTL, 0b00010011); /* last 3 bits are ODR */
-	Delay(1000);
+		/* Marker */
+		led0(true);
+		Delay(1);
+		led0(false);
 
-	/* ODR 200Hz */
-	writeADXL(ADXL_REG_FILTER_CTL, 0b00010100); /* last 3 bits are ODR */
-	Delay(1000);
+#ifdef DEBUGGING /* DEBUGGING */
+		dbinfoInt("[", msTicks, " ms] profile:");
+		dbprintln((char *)profilesADXL[i].name);
+		dbinfoInt("   expected current: ", profilesADXL[i].current, " nA");
+		dbinfoInt("   expected noise: ", profilesADXL[i].noise, " ug RMS");
+#endif /* DEBUGGING */
 
-	/* ODR 400Hz */
-	writeADXL(ADXL_REG_FILTER_CTL, 0b00010101); /* last 3 bits are ODR */
-	Delay(1000);
+		Delay(ADXL_PROFILE_DWELL);
+	}
 
 	/* Soft reset ADXL */
 	softResetADXL();
 
 #ifdef DEBUGGING /* DEBUGGING */
-	dbinfo("Testing done");
+	dbinfoInt("[", msTicks, " ms] testing done");
 #endif /* DEBUGGING */
 
 }
@@ -214,55 +489,68 @@ void testADXL (void)
 
 /**************************************************************************//**
  * @brief
- *   Read and display g values forever with a 100ms interval.
+ *   Read and display g values forever, one line for every new sample.
  *
  * @details
- *   The accelerometer is put in measurement mode at 12.5Hz ODR, new
- *   values are displayed every 100ms, if an interrupt was generated
- *   a delay of one second is called.
+ *   The accelerometer is put in measurement mode, every sample is read
+ *   exactly once by the GPIO interrupt handler (DATA_READY on INT2), the
+ *   MCU sleeps (EM1) in between. The counters show if samples were
+ *   missed or read twice.
  *****************************************************************************/
 void readValuesADXL (void)
 {
-	uint32_t counter = 0;
+	ADXL_Sample_TypeDef sample;
 
 	/* Enable measurement mode */
 	measureADXL(true);
+	configADXL_dataReady(true);
 
 	/* Infinite loop */
 	while (1)
 	{
-		led0(true); /* Enable LED0 */
+		/* Disable interrupts so a sample can't arrive between the check and sleeping */
+		__disable_irq();
+		while (drdyCount == 0)
+		{
+			EMU_EnterEM1();
+			__enable_irq();
+			__disable_irq();
+		}
+		__enable_irq();
+
+		readADXL_dataReady(&sample, 1);
 
-		/* Read XYZ sensor data */
-		readADXL_XYZDATA();
+		led0(true); /* Enable LED0 */
 
 #ifdef DEBUGGING /* DEBUGGING */
+		/* Convert XYZ sensor data */
+		int16_t mg[3];
+		convertADXL_mg12(&sample.x, mg, 1);
+
 		/* Print XYZ sensor data */
 		//dbprint("[");
 		dbprint("\r[");
-		dbprintInt(counter);
+		dbprintInt(drdyStats.samples);
 		dbprint("] X: ");
-		dbprintInt(convertGRangeToGValue(XYZDATA[0]));
+		dbprintInt(mg[0]);
 		dbprint(" mg | Y: ");
-		dbprintInt(convertGRangeToGValue(XYZDATA[1]));
+		dbprintInt(mg[1]);
 		dbprint(" mg | Z: ");
-		dbprintInt(convertGRangeToGValue(XYZDATA[2]));
-		dbprint(" mg   "); /* Extra spacing is to overwrite other data if it's remaining (see \r) */
+		dbprintInt(mg[2]);
+		dbprint(" mg | missed: ");
+		dbprintInt(drdyStats.missed);
+		dbprint(" | duplicates: ");
+		dbprintInt(drdyStats.duplicates);
+		dbprint("   "); /* Extra spacing is to overwrite other data if it's remaining (see \r) */
 		//dbprintln("");
 #endif /* DEBUGGING */
 
 		led0(false); /* Disable LED0 */
 
-		counter++;
-
-		Delay(100);
-
-		/* Read status register to acknowledge interrupt
-		 * (can be disabled by changing LINK/LOOP mode in ADXL_REG_ACT_INACT_CTL) */
+		/* Acknowledge interrupt (not necessary in loop mode) */
 		if (triggered)
 		{
-			Delay(1000);
-			readADXL(ADXL_REG_STATUS);
+			acknowledgeADXL();
 			triggered = false;
 		}
 	}
@@ -271,323 +559,3518 @@ void readValuesADXL (void)
 
 /**************************************************************************//**
  * @brief
- *   Soft reset accelerometer handler.
+ *   Run the self-test of the accelerometer.
  *
  * @details
- *   If the first ID check fails, the MCU is put on hold for one second
- *   and the ID gets checked again.
+ *   The SELF_TEST register applies an electrostatic force to the
+ *   sensor. X-Y-Z are averaged with the force off and on, the differences
+ *   (gravity cancels out) should be within the datasheet limits. The test
+ *   takes a fixed amount of readings at +-8g and 100 Hz, the range, ODR and
+ *   power mode are restored afterwards. The FIFO is flushed (disabled and
+ *   enabled again) so no +-8g sets get read as sets of the restored range.
+ *
+ * @note
+ *   The device shouldn't move during the test.
+ *
+ * @param[out] result
+ *   The output change of every axis and the duration of the test.
+ *
+ * @return
+ *   @li true - Self-test passed within ADXL_ST_BUDGET ms.
+ *   @li false - An axis is outside of the limits or the test took too long.
  *****************************************************************************/
-void resetHandlerADXL (void)
+bool selfTestADXL (ADXL_SelfTest_TypeDef *result)
 {
-	uint8_t retries = 0;
+	static const int16_t limits[3][2] = {
+		{ ADXL_ST_X_MIN, ADXL_ST_X_MAX },
+		{ ADXL_ST_Y_MIN, ADXL_ST_Y_MAX },
+		{ ADXL_ST_Z_MIN, ADXL_ST_Z_MAX }
+	};
 
-	/* Soft reset ADXL */
-	softResetADXL();
-
-	/* First try to get the correct ID failed */
-	if (!checkID_ADXL())
-	{
-		retries++;
+	uint32_t start = msTicks;
+	int32_t sum[2][3] = { { 0, 0, 0 }, { 0, 0, 0 } };
+	ADXL_Sample_TypeDef sample;
+	uint8_t saved[2], regs[2];
+	uint8_t fifo = getShadowADXL(ADXL_REG_FIFO_CONTROL);
 
-		Delay(1000);
+	/* FILTER_CTL and POWER_CTL are written in one burst */
+	saved[0] = getShadowADXL(ADXL_REG_FILTER_CTL);
+	saved[1] = getShadowADXL(ADXL_REG_POWER_CTL);
+	regs[0] = (saved[0] & 0b00110000) | 0b10000011; /* +-8g, 100 Hz, keep HALF_BW */
+	regs[1] = (saved[1] & 0b00110000) | 0b00000010; /* Measurement mode, keep LOW_NOISE */
+	burstWriteADXL(ADXL_REG_FILTER_CTL, regs, 2);
 
-		/* Soft reset */
-		softResetADXL();
+	for (uint8_t force = 0; force < 2; force++)
+	{
+		updateADXL(ADXL_REG_SELF_TEST, 0b00000001, force);
+		Delay(ADXL_ST_SETTLE);
 
-		/* Second try to get the correct ID failed */
-		if (!checkID_ADXL())
+		for (uint8_t i = 0; i < ADXL_ST_SAMPLES; i++)
 		{
-			retries++;
-
-			Delay(1000);
-
-			/* Soft reset */
-			softResetADXL();
+			readADXL_XYZTDATA(&sample);
+			sum[force][0] += sample.x;
+			sum[force][1] += sample.y;
+			sum[force][2] += sample.z;
+			Delay(10); /* Next sample */
+		}
+	}
 
-			/* Third try to get the correct ID failed
-			 * resorting to "hard" reset! */
-			if (!checkID_ADXL())
-			{
-				retries++;
+	updateADXL(ADXL_REG_SELF_TEST, 0b00000001, 0);
+	burstWriteADXL(ADXL_REG_FILTER_CTL, saved, 2);
 
-				powerADXL(false);
-				Delay(1000);
-				powerADXL(true);
+	/* Flush the sets measured during the test (FIFO mode bits to "disabled" and back) */
+	if ((fifo & 0b00000011) != 0)
+	{
+		writeADXL(ADXL_REG_FIFO_CONTROL, fifo & 0b11111100);
+		writeADXL(ADXL_REG_FIFO_CONTROL, fifo);
+	}
+	oldRangeSets = 0;
 
-				Delay(1000);
+	result->time = msTicks - start;
+	result->passed = (result->time <= ADXL_ST_BUDGET);
 
-				/* Soft reset */
-				softResetADXL();
+	for (uint8_t axis = 0; axis < 3; axis++)
+	{
+		/* Average difference in codes to mg (4 mg/LSB at +-8g) */
+		result->delta[axis] = ((sum[1][axis] - sum[0][axis]) * 4) / ADXL_ST_SAMPLES;
 
-				/* Last try to get the correct ID failed */
-				if (!checkID_ADXL())
-				{
-					Error(0);
-				}
-			}
-		}
+		if ((result->delta[axis] < limits[axis][0]) || (result->delta[axis] > limits[axis][1])) result->passed = false;
 	}
 
 #ifdef DEBUGGING /* DEBUGGING */
-	if (retries < 2) dbinfoInt("Soft reset ADXL done (", retries, " retries)");
-	else dbwarnInt("Soft reset ADXL done, had to \"hard reset\" (", retries, " retries)");
+	dbinfoInt("Self-test X: ", result->delta[0], " mg");
+	dbinfoInt("Self-test Y: ", result->delta[1], " mg");
+	dbinfoInt("Self-test Z: ", result->delta[2], " mg");
+	if (result->passed) dbinfoInt("Self-test passed (", result->time, " ms)");
+	else dbcritInt("Self-test failed (", result->time, " ms)");
 #endif /* DEBUGGING */
 
+	return (result->passed);
 }
 
 
 /**************************************************************************//**
  * @brief
- *   Read an SPI byte from the accelerometer (8 bits) using a given address.
+ *   Soft reset accelerometer handler.
  *
- * @param[in] address
- *   The register address to read from.
+ * @details
+ *   Runs the recovery state machine and sleeps (EM1) in between the
+ *   steps. Meant for the startup, in the main loop startADXL_recovery
+ *   is used so the rest of the code keeps running.
  *
- * @return
- *   The response (one byte, uint8_t).
+ * @note
+ *   The RTC needs to be initialized.
  *****************************************************************************/
-uint8_t readADXL (uint8_t address)
+void resetHandlerADXL (void)
 {
-	uint8_t response;
-
-	/* Set CS low (active low!) */
-	GPIO_PinOutClear(ADXL_NCS_PORT, ADXL_NCS_PIN);
+	startADXL_recovery();
 
-	/* 3-byte operation according to datasheet */
-	USART_SpiTransfer(USART0, 0x0B);            /* "read" instruction */
-	USART_SpiTransfer(USART0, address);         /* Address */
-	response = USART_SpiTransfer(USART0, 0x00); /* Read response */
+	while (recoveryBusyADXL())
+	{
+		/* Disable interrupts so the flag can't be set between the check and sleeping */
+		__disable_irq();
+		if (!adxlRecovery) EMU_EnterEM1();
+		__enable_irq();
 
-	/* Set CS high */
-	GPIO_PinOutSet(ADXL_NCS_PORT, ADXL_NCS_PIN);
+		if (adxlRecovery)
+		{
+			adxlRecovery = false;
+			recoveryStepADXL();
+		}
+	}
 
-	return (response);
+	if (recoveryState == ADXL_RECOVERY_FAILED) Error(0);
 }
 
 
 /**************************************************************************//**
  * @brief
- *   Write an SPI byte to the accelerometer (8 bits) using a given address
- *   and specified data.
+ *   Start the recovery of the accelerometer.
  *
- * @param[in] address
- *   The register address to write the data to (one byte, uint8_t).
+ * @details
+ *   The first attempts only do a soft reset, the next ones also cycle the
+ *   power. The wait after every failed attempt doubles (exponential
+ *   backoff). The steps are timed using RTC compare channel 1, every time
+ *   it fires the "adxlRecovery" flag is set and recoveryStepADXL needs to
+ *   be called, the MCU can sleep in between. When the ID is correct again
+ *   the registers are restored in one burst out of a copy of the shadow
+ *   (so the configuration and the power state are the same as before).
  *
- * @param[in] data
- *   The data to write to the address (one byte, uint8_t).
+ * @note
+ *   Synchronized sampling is stopped since it uses the same compare channel.
  *****************************************************************************/
-void writeADXL (uint8_t address, uint8_t data)
+void startADXL_recovery (void)
 {
-	/* Set CS low (active low!) */
-	GPIO_PinOutClear(ADXL_NCS_PORT, ADXL_NCS_PIN);
+	if (recoveryBusyADXL()) return;
 
-	/* 3-byte operation according to datasheet */
-	USART_SpiTransfer(USART0, 0x0A);    /* "write" instruction */
-	USART_SpiTransfer(USART0, address); /* Address */
-	USART_SpiTransfer(USART0, data);    /* Data */
+	stopADXL_sync();
 
-	/* Set CS high */
-	GPIO_PinOutSet(ADXL_NCS_PORT, ADXL_NCS_PIN);
+	for (uint8_t i = 0; i < ADXL_SHADOW_SIZE; i++) recoveryImage[i] = activeDevice->shadow[i];
+
+	recoveryAttempt = 0;
+	recoveryStart = RTC_CounterGet();
+	adxlRecovery = false;
+
+#ifdef DEBUGGING /* DEBUGGING */
+	dbwarn("Accelerometer recovery started");
+#endif /* DEBUGGING */
+
+	startAttemptADXL();
 }
 
 
 /**************************************************************************//**
  * @brief
- *   Read the X-Y-Z data registers in the XYZDATA[] field using burst reads.
+ *   Do the next step of the recovery.
  *
- * @details
- *   Response data gets put in XYZDATA array (global volatile variable).
+ * @note
+ *   Call this when the "adxlRecovery" flag is set (not in an interrupt handler).
+ *
+ * @return
+ *   The state after the step.
  *****************************************************************************/
-void readADXL_XYZDATA (void)
+ADXL_RecoveryState_TypeDef recoveryStepADXL (void)
 {
-	/* CS low (active low!) */
-	GPIO_PinOutClear(ADXL_NCS_PORT, ADXL_NCS_PIN);
+	if (recoveryState == ADXL_RECOVERY_POWER_OFF)
+	{
+		powerADXL(true);
+		enableSPIpinsADXL(true);
 
-	/* Burst read (address auto-increments) */
-	USART_SpiTransfer(USART0, 0x0B);				/* "read" instruction */
-	USART_SpiTransfer(USART0, ADXL_REG_XDATA); 		/* Address */
-	XYZDATA[0] = USART_SpiTransfer(USART0, 0x00);	/* Read response */
-	XYZDATA[1] = USART_SpiTransfer(USART0, 0x00);	/* Read response */
-	XYZDATA[2] = USART_SpiTransfer(USART0, 0x00);	/* Read response */
+		scheduleWakeupADXL(ADXL_MS_TO_TICKS(ADXL_POWERUP_WAIT));
+		recoveryState = ADXL_RECOVERY_POWER_UP;
+	}
+	else if (recoveryState == ADXL_RECOVERY_POWER_UP)
+	{
+		softResetADXL();
 
-	/* CS high */
-	GPIO_PinOutSet(ADXL_NCS_PORT, ADXL_NCS_PIN);
-}
+		scheduleWakeupADXL(ADXL_MS_TO_TICKS(ADXL_RESET_WAIT));
+		recoveryState = ADXL_RECOVERY_RESET;
+	}
+	else if (recoveryState == ADXL_RECOVERY_RESET)
+	{
+		recoveryAttempt++;
 
+		if (checkID_ADXL())
+		{
+			RTC_IntDisable(RTC_IEN_COMP1);
 
-/**************************************************************************//**
- * @brief
- *   Configure the Output Data Rate (ODR).
- *
- * @param[in] givenODR
- *   @li 0 - 12.5 Hz
- *   @li 1 - 25 Hz
- *   @li 2 - 50 Hz
- *   @li 3 - 100 Hz (reset default)
- *   @li 4 - 200 Hz
- *   @li 5 - 400 Hz
- *****************************************************************************/
-void configADXL_ODR (uint8_t givenODR)
-{
-	/* Get value in register */
-	uint8_t reg = readADXL(ADXL_REG_FILTER_CTL);
+			/* Restore the registers in one burst (SOFT_RESET excluded) */
+			burstWriteADXL(ADXL_SHADOW_FIRST + 1, &recoveryImage[1], ADXL_SHADOW_SIZE - 1);
+			recoveryState = ADXL_RECOVERY_IDLE;
 
-	/* AND with mask to keep the bits we don't want to change */
-	reg = reg & 0b11111000;
+			/* Let the rest of the code know */
+			if (powerHook != NULL) powerHook(getPowerStateADXL());
 
-	/* OR with new setting bits */
+#ifdef DEBUGGING /* DEBUGGING */
+			dbinfoInt("Accelerometer recovered, attempts: ", recoveryAttempt, "");
+			dbinfoInt("Recovery time: ", RTC_CounterGet() - recoveryStart, " RTC ticks");
+#endif /* DEBUGGING */
 
-	/* Set ODR (last three bits) */
-	if (givenODR == 0) writeADXL(ADXL_REG_FILTER_CTL, (reg | 0b00000000));
-	if (givenODR == 1) writeADXL(ADXL_REG_FILTER_CTL, (reg | 0b00000001));
-	if (givenODR == 2) writeADXL(ADXL_REG_FILTER_CTL, (reg | 0b00000010));
-	if (givenODR == 3) writeADXL(ADXL_REG_FILTER_CTL, (reg | 0b00000011));
-	if (givenODR == 4) writeADXL(ADXL_REG_FILTER_CTL, (reg | 0b00000100));
-	if (givenODR == 5) writeADXL(ADXL_REG_FILTER_CTL, (reg | 0b00000101));
-	else writeADXL(ADXL_REG_FILTER_CTL, (reg | 0b00000011));
+		}
+		else if (recoveryAttempt >= ADXL_RECOVERY_ATTEMPTS)
+		{
+			RTC_IntDisable(RTC_IEN_COMP1);
+			recoveryState = ADXL_RECOVERY_FAILED;
 
 #ifdef DEBUGGING /* DEBUGGING */
-	if (givenODR == 0) dbinfo("ODR set at 12.5 Hz");
-	else if (givenODR == 1) dbinfo("ODR set at 25 Hz");
-	else if (givenODR == 2) dbinfo("ODR set at 50 Hz");
-	else if (givenODR == 3) dbinfo("ODR set at 100 Hz");
-	else if (givenODR == 4) dbinfo("ODR set at 200 Hz");
-	else if (givenODR == 5) dbinfo("ODR set at 400 Hz");
-	else dbinfo("ODR set at 100 Hz (reset default)");
+			dbcritInt("Accelerometer recovery failed after ", recoveryAttempt, " attempts");
 #endif /* DEBUGGING */
 
+		}
+		else
+		{
+			scheduleWakeupADXL(ADXL_MS_TO_TICKS((uint32_t)ADXL_BACKOFF_MIN << (recoveryAttempt - 1)));
+			recoveryState = ADXL_RECOVERY_BACKOFF;
+		}
+	}
+	else if (recoveryState == ADXL_RECOVERY_BACKOFF) startAttemptADXL();
+
+	return (recoveryState);
 }
 
 
 /**************************************************************************//**
  * @brief
- *   Configure the measurement range and store the selected one in
- *   a global variable.
+ *   Check if the recovery is going on.
  *
- * @param[in] givenRange
- *   @li 0 - +- 2g
- *   @li 1 - +- 4g
- *   @li 2 - +- 8g
+ * @return
+ *   @li true - Recovery going on, the accelerometer can't be used.
+ *   @li false - No recovery going on (check the result of resetHandlerADXL
+ *       or recoveryStepADXL to see if it failed).
  *****************************************************************************/
-void configADXL_range (uint8_t givenRange)
+bool recoveryBusyADXL (void)
 {
-	/* Get value in register */
-	uint8_t reg = readADXL(ADXL_REG_FILTER_CTL);
-
-	/* AND with mask to keep the bits we don't want to change */
-	reg = reg & 0b00111111;
-
-	/* OR with new setting bits */
-
-	/* Set measurement range (first two bits) */
-	if (givenRange == 0) {
-		writeADXL(ADXL_REG_FILTER_CTL, (reg | 0b00000000));
-		range = 0;
-	}
-	else if (givenRange == 1) {
-		writeADXL(ADXL_REG_FILTER_CTL, (reg | 0b01000000));
-		range = 1;
-	}
-	else if (givenRange == 2) {
-		writeADXL(ADXL_REG_FILTER_CTL, (reg | 0b10000000));
-		range = 2;
-	}
-
-#ifdef DEBUGGING /* DEBUGGING */
-	if (range == 0) dbinfo("Measurement mode +- 2g selected");
-	else if (range == 1) dbinfo("Measurement mode +- 4g selected");
-	else if (range == 2) dbinfo("Measurement mode +- 8g selected");
-#endif /* DEBUGGING */
-
+	return ((recoveryState != ADXL_RECOVERY_IDLE) && (recoveryState != ADXL_RECOVERY_FAILED));
 }
 
 
 /**************************************************************************//**
  * @brief
- *   Configure the accelerometer to work in activity threshold mode.
+ *   Check if VCC of the accelerometer is enabled.
  *
  * @details
- *   Route activity detector to INT1 pin using INTMAP1, isolate bits
- *   and write settings to both threshold registers.
+ *   The SPI pins should only be enabled (for example after EM2) if this
+ *   returns true, otherwise the accelerometer gets powered through them.
  *
- * @param[in] gThreshold
- *   Threshold [g].
+ * @return
+ *   @li true - VCC is enabled.
+ *   @li false - VCC is disabled by powerDownADXL_gated or by the recovery
+ *       (ADXL_RECOVERY_POWER_OFF).
  *****************************************************************************/
-void configADXL_activity (uint8_t gThreshold)
+bool poweredADXL (void)
 {
-	/* Map activity detector to INT1 pin  */
-	writeADXL(ADXL_REG_INTMAP1, 0b00010000); /* Bit 4 selects activity detector */
-
-	/* Enable referenced activity threshold mode (last two bits) */
-	writeADXL(ADXL_REG_ACT_INACT_CTL, 0b00000011);
-
-	/* Convert g value to "codes":
-	 * THRESH_ACT [codes] = Threshold Value [g] × Scale Factor [LSB per g] */
-	uint16_t threshold;
-
-	if (range == 0) threshold = gThreshold * 1000;
-	else if (range == 1) threshold = gThreshold * 500;
-	else if (range == 2) threshold = gThreshold * 250;
-	else threshold = 0;
-
-	/* Isolate bits using masks and shifting */
-	uint8_t low  = (threshold & 0b0011111111);
-	uint8_t high = (threshold & 0b1100000000) >> 8;
-
-	/* Set threshold register values (total: 11bit unsigned) */
-	writeADXL(ADXL_REG_THRESH_ACT_L, low);  /* 7:0 bits used */
-	writeADXL(ADXL_REG_THRESH_ACT_H, high); /* 2:0 bits used */
-
-#ifdef DEBUGGING /* DEBUGGING */
-	dbinfoInt("Activity configured: ", gThreshold, " g");
-#endif /* DEBUGGING */
-
+	return (!gated && (recoveryState != ADXL_RECOVERY_POWER_OFF));
 }
 
+
 /**************************************************************************//**
  * @brief
- *   Enable or disable measurement mode.
+ *   Read every new sample using the DATA_READY interrupt on INT2.
+ *
+ * @details
+ *   DATA_READY replaces the FIFO watermark on INT2 (INT_LOW is kept). On
+ *   every rising edge the GPIO interrupt handler calls dataReadyADXL, which
+ *   queues one burst read of STATUS, FIFO_ENTRIES and X-Y-Z-TEMP. The read
+ *   clears DATA_READY so every sample gives one edge. The samples are
+ *   buffered until readADXL_dataReady is called. Synchronized sampling is
+ *   stopped since it uses INT2 as an output.
+ *
+ * @note
+ *   USART0 and the DMA need EM1, so the MCU can't go to EM2 while this is
+ *   enabled.
  *
  * @param[in] enabled
- *   @li True - Enable measurement mode.
- *   @li False - Disable measurement mode (standby).
+ *   @li true - Map DATA_READY to INT2 and reset the counters.
+ *   @li false - Put the previous INT2 mapping back.
  *****************************************************************************/
-void measureADXL (bool enabled)
+void configADXL_dataReady (bool enabled)
 {
+	if (enabled == drdyEnabled) return;
+
 	if (enabled)
 	{
-		/* Get value in register */
-		uint8_t reg = readADXL(ADXL_REG_POWER_CTL);
+		stopADXL_sync();
 
-		/* AND with mask to keep the bits we don't want to change */
-		reg = reg & 0b11111100;
+		drdyRead.command = ADXL_CMD_READ_REG;
+		drdyRead.address = ADXL_REG_STATUS;
+		drdyRead.buffer = drdyBuffer;
+		drdyRead.length = sizeof(drdyBuffer);
+		drdyRead.callback = &dataReadyDoneADXL;
+		drdyRead.user = NULL;
+		drdyRead.device = NULL;
+		drdyRead.done = true;
 
-		/* OR with new setting bits */
+		drdyHead = 0;
+		drdyCount = 0;
+		drdyStats.samples = 0;
+		drdyStats.missed = 0;
+		drdyStats.duplicates = 0;
+		drdyStats.overflows = 0;
+		drdyMeasuring = false;
 
-		/* Enable measurements */
-		writeADXL(ADXL_REG_POWER_CTL, reg | 0b00000010); /* Last 2 bits are measurement mode */
+		drdySavedIntmap2 = getShadowADXL(ADXL_REG_INTMAP2);
+		writeADXL(ADXL_REG_INTMAP2, (drdySavedIntmap2 & 0b10000000) | 0b00000001);
+
+		drdyEnabled = true;
+
+		/* INT2 could already be high (no edge), the first read clears it */
+		GPIO_IntClear(1 << ADXL_INT2_PIN);
+		if (GPIO_PinInGet(ADXL_INT2_PORT, ADXL_INT2_PIN)) dataReadyADXL();
+
+#ifdef DEBUGGING /* DEBUGGING */
+		dbinfo("DATA_READY acquisition enabled (INT2)");
+#endif /* DEBUGGING */
+
+	}
+	else
+	{
+		drdyEnabled = false;
+		waitADXL(&drdyRead);
+
+		writeADXL(ADXL_REG_INTMAP2, drdySavedIntmap2);
+
+#ifdef DEBUGGING /* DEBUGGING */
+		dbinfoInt("DATA_READY acquisition disabled, samples: ", drdyStats.samples, "");
+		dbinfoInt("Missed: ", drdyStats.missed, "");
+		dbinfoInt("Duplicates: ", drdyStats.duplicates, "");
+#endif /* DEBUGGING */
+
+	}
+}
+
+
+/**************************************************************************//**
+ * @brief
+ *   Start reading a new sample after a DATA_READY edge.
+ *
+ * @details
+ *   Only queues the read (the DMA interrupt handler finishes it), so
+ *   the GPIO interrupt handler doesn't wait for the bus. If the queue is
+ *   full INT2 stays high, the main loop should call this again when the pin
+ *   is high (a late read is counted as missed samples if needed).
+ *
+ * @note
+ *   This method is called from the GPIO interrupt handler.
+ *
+ * @return
+ *   @li true - The edge was a DATA_READY interrupt.
+ *   @li false - DATA_READY acquisition isn't enabled.
+ *****************************************************************************/
+bool dataReadyADXL (void)
+{
+	CORE_DECLARE_IRQ_STATE;
+
+	if (!drdyEnabled) return (false);
+
+	CORE_ENTER_ATOMIC();
+
+	/* Only one read at a time, the edge of the next sample comes after it cleared INT2 */
+	if (drdyRead.done)
+	{
+		drdyEdge = RTC_CounterGet();
+		queueADXL(&drdyRead);
+	}
+
+	CORE_EXIT_ATOMIC();
+
+	return (true);
+}
+
+
+/**************************************************************************//**
+ * @brief
+ *   Check if the DATA_READY acquisition is enabled.
+ *
+ * @return
+ *   @li true - INT2 is DATA_READY, the GPIO interrupt handler reads the samples.
+ *   @li false - INT2 has its normal function (FIFO watermark).
+ *****************************************************************************/
+bool dataReadyEnabledADXL (void)
+{
+	return (drdyEnabled);
+}
+
+
+/**************************************************************************//**
+ * @brief
+ *   Get the samples read using DATA_READY.
+ *
+ * @details
+ *   If temperature compensation is enabled the offsets are updated here
+ *   (not in the interrupt handler) with the temperature of the newest
+ *   buffered sample, the next samples are corrected with them. Call this
+ *   regularly so the offsets follow the temperature.
+ *
+ * @param[out] samples
+ *   The buffer for the samples (oldest first).
+ *
+ * @param[in] maxSamples
+ *   The amount of samples that fit in the buffer.
+ *
+ * @return
+ *   The amount of samples copied.
+ *****************************************************************************/
+uint8_t readADXL_dataReady (ADXL_Sample_TypeDef *samples, uint8_t maxSamples)
+{
+	CORE_DECLARE_IRQ_STATE;
+	uint8_t count = 0;
+
+	CORE_ENTER_ATOMIC();
+
+	/* The offsets are used by the DMA interrupt handler */
+	if ((tempTable != NULL) && (drdyCount > 0)) updateTempOffsetADXL(drdySamples[(drdyHead + drdyCount - 1) % ADXL_DRDY_BUFFER].temp);
+
+	while ((drdyCount > 0) && (count < maxSamples))
+	{
+		samples[count] = drdySamples[drdyHead];
+		drdyHead = (drdyHead + 1) % ADXL_DRDY_BUFFER;
+		drdyCount--;
+		count++;
+	}
+
+	CORE_EXIT_ATOMIC();
+
+	return (count);
+}
+
+
+/**************************************************************************//**
+ * @brief
+ *   Get the counters of the DATA_READY acquisition.
+ *
+ * @param[out] stats
+ *   The counters.
+ *****************************************************************************/
+void getDataReadyADXL (ADXL_DataReady_TypeDef *stats)
+{
+	CORE_DECLARE_IRQ_STATE;
+
+	CORE_ENTER_ATOMIC();
+	*stats = drdyStats;
+	CORE_EXIT_ATOMIC();
+}
+
+
+/**************************************************************************//**
+ * @brief
+ *   Cut the power of the accelerometer(s) for a long idle period.
+ *
+ * @details
+ *   The shadow of every device is saved so powerUpADXL_restore can bring
+ *   back the whole configuration. The SPI pins are disabled so the
+ *   accelerometer doesn't get powered through them. Synchronized sampling
+ *   is stopped since INT2 would be driven high. The FIFO contents are lost.
+ *
+ *   For sparse sampling (one burst every few minutes) this uses less
+ *   energy than the wake-up mode (270 nA), the price is the turn-on time.
+ *****************************************************************************/
+void powerDownADXL_gated (void)
+{
+	if (gated) return;
+
+	stopADXL_sync();
+	waitQueueADXL();
+
+	for (uint8_t i = 0; i < deviceCount; i++)
+	{
+		for (uint8_t j = 0; j < ADXL_SHADOW_SIZE; j++) gateImage[i][j] = devicesADXL[i]->shadow[j];
+	}
+
+	enableSPIpinsADXL(false);
+	powerADXL(false);
+
+	gated = true;
+}
+
+
+/**************************************************************************//**
+ * @brief
+ *   Power the accelerometer(s) up again and restore the configuration.
+ *
+ * @details
+ *   After the turn-on time (ADXL_POWERUP_WAIT, slept in EM2 with RTC
+ *   compare channel 1 as wake-up) the registers of every device are
+ *   restored in one burst each (SOFT_RESET excluded). The bursts are queued
+ *   back to back, the MCU waits in EM1. POWER_CTL is written last in the
+ *   burst so the measurements only start with the filter settings in place.
+ *
+ * @note
+ *   The RTC needs to be initialized. Synchronized sampling is stopped by
+ *   powerDownADXL_gated, the recovery can't be going on (compare
+ *   channel 1 is used for the wait).
+ *
+ * @return
+ *   The time from enabling VCC until the configuration is restored (RTC ticks, 0 if it wasn't gated).
+ *****************************************************************************/
+uint32_t powerUpADXL_restore (void)
+{
+	if (!gated) return (0);
+
+	uint32_t start = RTC_CounterGet();
+
+	powerADXL(true); /* Resets the shadows */
+	enableSPIpinsADXL(true);
+
+	sleepADXL_ticks(ADXL_MS_TO_TICKS(ADXL_POWERUP_WAIT));
+
+#ifdef DEBUGGING /* DEBUGGING */
+	uint32_t burstStart = RTC_CounterGet();
+#endif /* DEBUGGING */
+
+	for (uint8_t i = 0; i < deviceCount; i++)
+	{
+		gateRestore[i].command = ADXL_CMD_WRITE_REG;
+		gateRestore[i].address = ADXL_SHADOW_FIRST + 1;
+		gateRestore[i].buffer = &gateImage[i][1];
+		gateRestore[i].length = ADXL_SHADOW_SIZE - 1;
+		gateRestore[i].callback = NULL;
+		gateRestore[i].user = NULL;
+		gateRestore[i].device = devicesADXL[i];
+
+		while (!queueADXL(&gateRestore[i])) EMU_EnterEM1();
+	}
+
+	waitQueueADXL();
+	gated = false;
+
+	uint32_t ticks = ticksSinceADXL(start);
+
+	/* Let the rest of the code know */
+	if (powerHook != NULL) powerHook(getPowerStateADXL());
+
+#ifdef DEBUGGING /* DEBUGGING */
+	dbinfoInt("Accelerometer restored after ", ticks, " RTC ticks");
+	dbinfoInt("Restore burst(s): ", ticksSinceADXL(burstStart), " RTC ticks");
+#endif /* DEBUGGING */
+
+	return (ticks);
+}
+
+
+/**************************************************************************//**
+ * @brief
+ *   Check if the power of the accelerometer is cut by powerDownADXL_gated.
+ *
+ * @return
+ *   @li true - VCC is disabled, the accelerometer can't be used.
+ *   @li false - The accelerometer is powered.
+ *****************************************************************************/
+bool gatedADXL (void)
+{
+	return (gated);
+}
+
+
+/**************************************************************************//**
+ * @brief
+ *   Read an SPI byte from the accelerometer (8 bits) using a given address.
+ *
+ * @param[in] address
+ *   The register address to read from.
+ *
+ *
+ * @param[in] caller
+ *   Only with ADXL_TRACE: the name of the calling method (passed by the
+ *   readADXL macro in "accel.h").
+ *
+ * @return
+ *   The response (one byte, uint8_t).
+ *****************************************************************************/
+#ifdef ADXL_TRACE /* ADXL_TRACE */
+uint8_t readADXL_traced (uint8_t address, const char *caller)
+#else
+uint8_t readADXL (uint8_t address)
+#endif /* ADXL_TRACE */
+{
+	uint8_t response;
+
+	/* 3-byte operation according to datasheet */
+	transferADXL(ADXL_CMD_READ_REG, address, &response, 1, ADXL_CALLER);
+
+	return (response);
+}
+
+
+/**************************************************************************//**
+ * @brief
+ *   Write an SPI byte to the accelerometer (8 bits) using a given address
+ *   and specified data.
+ *
+ * @param[in] address
+ *   The register address to write the data to (one byte, uint8_t).
+ *
+ * @param[in] data
+ *   The data to write to the address (one byte, uint8_t).
+ *
+ * @param[in] caller
+ *   Only with ADXL_TRACE: the name of the calling method.
+ *****************************************************************************/
+#ifdef ADXL_TRACE /* ADXL_TRACE */
+void writeADXL_traced (uint8_t address, uint8_t data, const char *caller)
+#else
+void writeADXL (uint8_t address, uint8_t data)
+#endif /* ADXL_TRACE */
+{
+	/* 3-byte operation according to datasheet */
+	transferADXL(ADXL_CMD_WRITE_REG, address, &data, 1, ADXL_CALLER);
+}
+
+
+/**************************************************************************//**
+ * @brief
+ *   Read a number of consecutive registers in one CS cycle.
+ *
+ * @details
+ *   The address auto-increments on the accelerometer side. The MCU
+ *   waits in EM1 until the DMA transfer is done.
+ *
+ * @param[in] address
+ *   The address of the first register to read from.
+ *
+ * @param[out] buffer
+ *   The buffer to put the response bytes in.
+ *
+ * @param[in] length
+ *   The amount of bytes to read (can be larger than one DMA cycle).
+ *
+ * @param[in] caller
+ *   Only with ADXL_TRACE: the name of the calling method.
+ *****************************************************************************/
+#ifdef ADXL_TRACE /* ADXL_TRACE */
+void burstReadADXL_traced (uint8_t address, uint8_t *buffer, uint16_t length, const char *caller)
+#else
+void burstReadADXL (uint8_t address, uint8_t *buffer, uint16_t length)
+#endif /* ADXL_TRACE */
+{
+	transferADXL(ADXL_CMD_READ_REG, address, buffer, length, ADXL_CALLER);
+}
+
+
+/**************************************************************************//**
+ * @brief
+ *   Write a number of consecutive registers in one CS cycle.
+ *
+ * @details
+ *   The address auto-increments on the accelerometer side. The MCU
+ *   waits in EM1 until the DMA transfer is done.
+ *
+ * @param[in] address
+ *   The address of the first register to write to.
+ *
+ * @param[in] buffer
+ *   The data to write.
+ *
+ * @param[in] length
+ *   The amount of bytes to write (can be larger than one DMA cycle).
+ *
+ * @param[in] caller
+ *   Only with ADXL_TRACE: the name of the calling method.
+ *****************************************************************************/
+#ifdef ADXL_TRACE /* ADXL_TRACE */
+void burstWriteADXL_traced (uint8_t address, const uint8_t *buffer, uint16_t length, const char *caller)
+#else
+void burstWriteADXL (uint8_t address, const uint8_t *buffer, uint16_t length)
+#endif /* ADXL_TRACE */
+{
+	/* The buffer is only read by the DMA during a write */
+	transferADXL(ADXL_CMD_WRITE_REG, address, (uint8_t *)buffer, length, ADXL_CALLER);
+}
+
+
+/**************************************************************************//**
+ * @brief
+ *   Read the X-Y-Z data registers in the XYZDATA[] field using burst reads.
+ *
+ * @details
+ *   Response data gets put in XYZDATA array (global volatile variable).
+ *****************************************************************************/
+void readADXL_XYZDATA (void)
+{
+	uint8_t buffer[3];
+
+	/* Burst read (address auto-increments) */
+	burstReadADXL(ADXL_REG_XDATA, buffer, 3);
+
+	XYZDATA[0] = buffer[0];
+	XYZDATA[1] = buffer[1];
+	XYZDATA[2] = buffer[2];
+}
+
+
+/**************************************************************************//**
+ * @brief
+ *   Read the full resolution X-Y-Z and temperature data registers
+ *   using one burst read.
+ *
+ * @details
+ *   XDATA_L up to TEMP_H (8 bytes) are read in one CS cycle, this way
+ *   all values belong to the same sample. The upper four bits of the
+ *   high bytes are sign extension bits, so combining the two bytes
+ *   results in a correct signed value.
+ *
+ *   If temperature compensation is configured, the interpolated offsets
+ *   are subtracted from X-Y-Z. The offsets are only recalculated when the
+ *   temperature changes by ADXL_TEMP_HYSTERESIS or more, otherwise this
+ *   costs three shifts and subtractions.
+ *
+ * @param[out] sample
+ *   The sample to put the values in.
+ *****************************************************************************/
+void readADXL_XYZTDATA (ADXL_Sample_TypeDef *sample)
+{
+	uint8_t buffer[8];
+
+	/* Burst read (address auto-increments) */
+	burstReadADXL(ADXL_REG_XDATA_L, buffer, 8);
+
+	sample->x    = (int16_t)((buffer[1] << 8) | buffer[0]);
+	sample->y    = (int16_t)((buffer[3] << 8) | buffer[2]);
+	sample->z    = (int16_t)((buffer[5] << 8) | buffer[4]);
+	sample->temp = (int16_t)((buffer[7] << 8) | buffer[6]);
+	sample->range = range;
+
+	if (tempTable != NULL)
+	{
+		updateTempOffsetADXL(sample->temp);
+
+		/* Offsets [mg] to codes (1, 2 or 4 mg/LSB) */
+		sample->x -= tempOffset[0] >> range;
+		sample->y -= tempOffset[1] >> range;
+		sample->z -= tempOffset[2] >> range;
+	}
+}
+
+
+/**************************************************************************//**
+ * @brief
+ *   Configure the offset-vs-temperature correction.
+ *
+ * @details
+ *   The offsets are linearly interpolated between the points of the
+ *   table (and kept constant outside of it). They are applied to the
+ *   samples read by readADXL_XYZTDATA and to the sets read by
+ *   readADXL_FIFO (which reads TEMP in the same burst as FIFO_ENTRIES,
+ *   so the offsets follow the temperature at the moment of the read).
+ *
+ * @note
+ *   The table isn't copied, it can be located in flash (stored
+ *   calibration data) but needs to stay valid.
+ *
+ * @param[in] table
+ *   The table, sorted on temperature (NULL disables the correction).
+ *
+ * @param[in] points
+ *   The amount of points in the table (1 - ADXL_TEMP_POINTS_MAX).
+ *****************************************************************************/
+void configADXL_tempComp (const ADXL_TempPoint_TypeDef *table, uint8_t points)
+{
+	if ((points == 0) || (points > ADXL_TEMP_POINTS_MAX)) table = NULL;
+
+	tempTable = table;
+	tempPoints = points;
+	tempCached = INT16_MIN;
+
+	/* No correction until the first temperature is read */
+	tempOffset[0] = 0;
+	tempOffset[1] = 0;
+	tempOffset[2] = 0;
+
+#ifdef DEBUGGING /* DEBUGGING */
+	if (table == NULL) dbinfo("Temperature compensation disabled");
+	else dbinfoInt("Temperature compensation enabled (", points, " points)");
+#endif /* DEBUGGING */
+
+}
+
+
+/**************************************************************************//**
+ * @brief
+ *   Convert a raw temperature value to degrees Celsius.
+ *
+ * @param[in] raw
+ *   The raw temperature value [LSB].
+ *
+ * @return
+ *   The temperature [0.1 degrees C] (typical scale factor and bias).
+ *****************************************************************************/
+int16_t convertADXL_temp (int16_t raw)
+{
+	/* 0.065 degrees C/LSB = 0.65 tenths of a degree = 13/20 */
+	return (250 + ((raw - ADXL_TEMP_BIAS) * 13) / 20);
+}
+
+
+/**************************************************************************//**
+ * @brief
+ *   Configure the FIFO and route the watermark interrupt to INT2.
+ *
+ * @details
+ *   FIFO_CONTROL and FIFO_SAMPLES are written in one burst, the
+ *   temperature isn't stored in the FIFO so one sample set is always
+ *   three entries (X-Y-Z).
+ *
+ * @param[in] mode
+ *   @li ADXL_FIFO_DISABLED - FIFO disabled, watermark interrupt unmapped.
+ *   @li ADXL_FIFO_OLDEST - Oldest saved mode.
+ *   @li ADXL_FIFO_STREAM - Stream mode.
+ *   @li ADXL_FIFO_TRIGGERED - Triggered mode.
+ *
+ * @param[in] watermark
+ *   Amount of entries (not sample sets!) that need to be in the FIFO
+ *   before INT2 goes high (max 511).
+ *****************************************************************************/
+void configADXL_FIFO (uint8_t mode, uint16_t watermark)
+{
+	uint8_t fifo[2];
+
+	if (watermark > (ADXL_FIFO_SIZE - 1)) watermark = ADXL_FIFO_SIZE - 1;
+
+	/* FIFO_CONTROL: AH bit (bit 3) is the MSB of the watermark */
+	fifo[0] = ((watermark & 0x100) >> 5) | (mode & 0b00000011);
+
+	/* FIFO_SAMPLES: lower 8 bits of the watermark */
+	fifo[1] = watermark & 0xFF;
+
+	burstWriteADXL(ADXL_REG_FIFO_CONTROL, fifo, 2);
+
+	/* Map (or unmap) the FIFO watermark to the INT2 pin (bit 2) */
+	if (mode == ADXL_FIFO_DISABLED) updateADXL(ADXL_REG_INTMAP2, 0b00000100, 0b00000000);
+	else updateADXL(ADXL_REG_INTMAP2, 0b00000100, 0b00000100);
+
+#ifdef DEBUGGING /* DEBUGGING */
+	if (mode == ADXL_FIFO_DISABLED) dbinfo("FIFO disabled");
+	else dbinfoInt("FIFO enabled, watermark at ", watermark, " entries");
+#endif /* DEBUGGING */
+
+}
+
+
+/**************************************************************************//**
+ * @brief
+ *   Read the amount of entries currently in the FIFO.
+ *
+ * @return
+ *   The amount of entries (0 - 512).
+ *****************************************************************************/
+uint16_t readADXL_FIFOentries (void)
+{
+	uint8_t entries[2];
+
+	/* Burst read (address auto-increments) */
+	burstReadADXL(ADXL_REG_FIFO_ENTRIES_L, entries, 2);
+
+	return (((entries[1] & 0b00000011) << 8) | entries[0]);
+}
+
+
+/**************************************************************************//**
+ * @brief
+ *   Drain the FIFO in one burst and decode the entries to sample sets.
+ *
+ * @details
+ *   Only complete X-Y-Z sets are read. The raw entries are put in the
+ *   given buffer by the DMA and decoded in place: every 16-bit entry is
+ *   replaced by its sign-extended value at the position indicated by
+ *   its axis tag (bits 15:14). A decoded set (with its range tag) is
+ *   larger than its three raw entries, so the sets are decoded from the
+ *   last one to the first one.
+ *
+ * @note
+ *   The sets that were already in the FIFO during an automatic range
+ *   switch get the previous range as tag. With temperature compensation,
+ *   FIFO_ENTRIES up to TEMP_H are read in one burst and all sets get the
+ *   offsets of that temperature.
+ *
+ * @param[out] samples
+ *   The buffer to put the decoded sample sets in.
+ *
+ * @param[in] maxSamples
+ *   The amount of sample sets that fit in the buffer.
+ *
+ * @return
+ *   The amount of sample sets put in the buffer.
+ *****************************************************************************/
+uint16_t readADXL_FIFO (ADXL_FifoSample_TypeDef *samples, uint16_t maxSamples)
+{
+	uint16_t sets;
+
+	if (tempTable != NULL)
+	{
+		uint8_t buffer[10];
+
+		/* FIFO_ENTRIES_L up to TEMP_H in one burst (the temperature comes for free) */
+		burstReadADXL(ADXL_REG_FIFO_ENTRIES_L, buffer, 10);
+
+		sets = (((buffer[1] & 0b00000011) << 8) | buffer[0]) / 3;
+		updateTempOffsetADXL((int16_t)((buffer[9] << 8) | buffer[8]));
+	}
+	else sets = readADXL_FIFOentries() / 3;
+
+	if (sets > maxSamples) sets = maxSamples;
+	if (sets == 0) return (0);
+
+	/* Read all entries in one CS cycle (2 bytes per entry, LSB first) */
+	transferADXL(ADXL_CMD_READ_FIFO, 0x00, (uint8_t *)samples, sets * 3 * 2, __func__);
+
+	return (decodeFifoADXL(samples, sets, activeDevice));
+}
+
+
+/**************************************************************************//**
+ * @brief
+ *   Configure the FIFO to capture samples around an activity event.
+ *
+ * @details
+ *   In triggered mode the FIFO keeps the last preSets sample sets until
+ *   the activity detector triggers, after which it keeps filling up.
+ *   FIFO_SAMPLES holds the amount of pre-trigger entries in this mode,
+ *   so the watermark interrupt is removed from INT2 (it would be high
+ *   all the time). The activity interrupt on INT1 starts the capture.
+ *
+ * @param[in] preSets
+ *   The amount of X-Y-Z sets to keep from before the event.
+ *
+ * @param[in] postSets
+ *   The amount of X-Y-Z sets to capture after the event
+ *   (preSets + postSets <= ADXL_FIFO_SETS, 0 disables the capture).
+ *****************************************************************************/
+void configADXL_capture (uint16_t preSets, uint16_t postSets)
+{
+	if (preSets > (ADXL_FIFO_SETS - 1)) preSets = ADXL_FIFO_SETS - 1;
+	if ((preSets + postSets) > ADXL_FIFO_SETS) postSets = ADXL_FIFO_SETS - preSets;
+
+	capturePre = preSets;
+	capturePost = postSets;
+
+	if (postSets == 0)
+	{
+		configADXL_FIFO(ADXL_FIFO_DISABLED, 0);
+		return;
+	}
+
+	/* (Re)writing the FIFO mode also clears the FIFO */
+	configADXL_FIFO(ADXL_FIFO_TRIGGERED, preSets * 3);
+	updateADXL(ADXL_REG_INTMAP2, 0b00000100, 0b00000000);
+
+#ifdef DEBUGGING /* DEBUGGING */
+	dbinfoInt("Event capture armed, ", preSets, " sets before the event");
+#endif /* DEBUGGING */
+
+}
+
+
+/**************************************************************************//**
+ * @brief
+ *   Check if the event capture is configured.
+ *
+ * @return
+ *   @li true - An activity interrupt should be handled by captureADXL_event.
+ *   @li false - The event capture is disabled.
+ *****************************************************************************/
+bool captureArmedADXL (void)
+{
+	return (capturePost > 0);
+}
+
+
+/**************************************************************************//**
+ * @brief
+ *   Capture the samples around an activity event and re-arm the capture.
+ *
+ * @details
+ *   Call this after the activity interrupt on INT1 fired. The MCU sleeps
+ *   in EM2 (woken up by RTC compare channel 1) for the time the missing
+ *   post-trigger sets need, the FIFO entry count is then checked again.
+ *   INT2 can't be used here, in triggered mode the watermark (FIFO_SAMPLES
+ *   = pre-trigger entries) stays high. After all sets are stored (or the
+ *   timeout of twice the expected time is reached) the sets of the record
+ *   are drained in one burst, sets that arrived afterwards are discarded.
+ *
+ * @param[in,out] event
+ *   The event record, samples and maxSets need to be filled in.
+ *
+ * @return
+ *   @li true - All requested sets were captured.
+ *   @li false - Less sets were captured (timeout or buffer too small).
+ *****************************************************************************/
+bool captureADXL_event (ADXL_Event_TypeDef *event)
+{
+	uint16_t target = (capturePre + capturePost) * 3;
+	uint16_t sets = ((capturePre + capturePost) < event->maxSets) ? (capturePre + capturePost) : event->maxSets;
+	uint16_t entries;
+
+	/* Period of 12.5 Hz in RTC ticks, halved for every next ODR setting */
+	uint32_t period = ((ADXL_SYNC_CLOCK * 2) / 25) >> (getShadowADXL(ADXL_REG_FILTER_CTL) & 0b00000111);
+	uint32_t budget = 2 * capturePost; /* [sample periods] */
+
+	event->timestamp = RTC_CounterGet();
+
+	while (((entries = readADXL_FIFOentries()) < target) && (budget > 0))
+	{
+		/* Sets still to come (rounded up) */
+		uint32_t wait = ((target - entries) + 2) / 3;
+		if (wait > budget) wait = budget;
+
+		sleepADXL_ticks(wait * period);
+		budget -= wait;
+	}
+
+	event->sets = readADXL_FIFO(event->samples, sets);
+	event->preSets = (event->sets < capturePre) ? event->sets : capturePre;
+
+	/* Re-arm: rewriting the FIFO mode clears the FIFO */
+	updateADXL(ADXL_REG_FIFO_CONTROL, 0b00000011, ADXL_FIFO_DISABLED);
+	updateADXL(ADXL_REG_FIFO_CONTROL, 0b00000011, ADXL_FIFO_TRIGGERED);
+
+#ifdef DEBUGGING /* DEBUGGING */
+	dbinfoInt("Event captured: ", event->sets, " sets");
+#endif /* DEBUGGING */
+
+	return (event->sets == (capturePre + capturePost));
+}
+
+
+/**************************************************************************//**
+ * @brief
+ *   Start synchronized sampling: the MCU triggers every sample.
+ *
+ * @details
+ *   EXT_SAMPLE is set in FILTER_CTL so the accelerometer takes a sample
+ *   on every rising edge on INT2, which becomes an MCU output. RTC
+ *   compare channel 1 generates the triggers, so every sample lands on
+ *   a known RTC tick (also in EM2). The RTC has no compare output and
+ *   the Happy Gecko has no LETIMER, so the pin is driven by the RTC
+ *   interrupt handler (see triggerADXL_sync for the jitter). The ODR is set to the lowest setting
+ *   at or above the trigger rate (this sets the filter bandwidth). The
+ *   samples go to the FIFO in stream mode, every ADXL_SYNC_BLOCK triggers
+ *   the "syncDrain" flag is set. The FIFO is flushed after EXT_SAMPLE is
+ *   set, so the first set read by readADXL_sync is the first trigger.
+ *
+ * @note
+ *   The actual rate is ADXL_SYNC_CLOCK divided by a whole number of ticks,
+ *   use getSyncPeriodADXL to get the exact period.
+ *
+ * @param[in] rate
+ *   The sample rate [Hz] (1 - 400).
+ *****************************************************************************/
+void configADXL_sync (uint16_t rate)
+{
+	if (rate == 0) rate = 1;
+	if (rate > 400) rate = 400;
+
+	/* Lowest ODR setting at or above the trigger rate (12.5 Hz * 2^odr) */
+	uint8_t odr = 0;
+	while ((odr < 5) && (((25 << odr) / 2) < rate)) odr++;
+
+	savedFilterCtl = getShadowADXL(ADXL_REG_FILTER_CTL);
+	savedIntmap2 = getShadowADXL(ADXL_REG_INTMAP2);
+
+	/* INT2 can't be an output of the accelerometer anymore */
+	updateADXL(ADXL_REG_INTMAP2, 0xFF, 0x00);
+	GPIO_IntConfig(ADXL_INT2_PORT, ADXL_INT2_PIN, 1, 0, false);
+	GPIO_PinModeSet(ADXL_INT2_PORT, ADXL_INT2_PIN, gpioModePushPull, 0);
+
+	/* Set EXT_SAMPLE (bit 3) and the ODR */
+	updateADXL(ADXL_REG_FILTER_CTL, 0b00001111, (0b00001000 | odr));
+
+	/* Flush the sets taken on the clock of the accelerometer (always written, the shadow
+	 * can already hold stream mode) and stream the triggered samples to the FIFO */
+	uint8_t fifo = getShadowADXL(ADXL_REG_FIFO_CONTROL) & 0b11111100;
+	writeADXL(ADXL_REG_FIFO_CONTROL, fifo | ADXL_FIFO_DISABLED);
+	writeADXL(ADXL_REG_FIFO_CONTROL, fifo | ADXL_FIFO_STREAM);
+	oldRangeSets = 0;
+
+	syncPeriod = ADXL_SYNC_CLOCK / rate;
+	syncTriggers = 0;
+
+	/* First trigger one period from now */
+	uint32_t top = RTC_CompareGet(0);
+	syncStart = RTC_CounterGet() + syncPeriod;
+	if (syncStart > top) syncStart -= (top + 1);
+
+	syncNext = syncStart;
+
+	RTC_CompareSet(1, syncStart);
+	RTC_IntClear(RTC_IFC_COMP1);
+	RTC_IntEnable(RTC_IEN_COMP1);
+
+#ifdef DEBUGGING /* DEBUGGING */
+	dbinfoInt("Synchronized sampling, period: ", syncPeriod, " RTC ticks");
+#endif /* DEBUGGING */
+
+}
+
+
+/**************************************************************************//**
+ * @brief
+ *   Stop synchronized sampling and give INT2 back to the accelerometer.
+ *****************************************************************************/
+void stopADXL_sync (void)
+{
+	if (syncPeriod == 0) return;
+
+	RTC_IntDisable(RTC_IEN_COMP1);
+	syncPeriod = 0;
+
+	updateADXL(ADXL_REG_FILTER_CTL, 0xFF, savedFilterCtl);
+	updateADXL(ADXL_REG_INTMAP2, 0xFF, savedIntmap2);
+
+	GPIO_PinModeSet(ADXL_INT2_PORT, ADXL_INT2_PIN, gpioModeInput, 1);
+	GPIO_IntConfig(ADXL_INT2_PORT, ADXL_INT2_PIN, 1, 0, true);
+
+#ifdef DEBUGGING /* DEBUGGING */
+	dbinfo("Synchronized sampling stopped");
+#endif /* DEBUGGING */
+
+}
+
+
+/**************************************************************************//**
+ * @brief
+ *   Trigger one sample and schedule the next trigger.
+ *
+ * @details
+ *   The accelerometer samples on the rising edge. The pin stays high until
+ *   the RTC counter moved ADXL_SYNC_PULSE full ticks past the edge (at
+ *   least 30.5 us, at most 61 us). The width is checked against the RTC
+ *   counter, so it doesn't depend on the core clock or the compiler (the
+ *   old pulse was only a few core cycles wide).
+ *
+ * @note
+ *   This method is called from the RTC interrupt handler, the edge comes
+ *   in software: the sample instant is the compare tick plus the wake-up
+ *   from EM2 and the interrupt latency. That's a few us, longer if a
+ *   higher priority interrupt (DMA, GPIO) or a critical section is
+ *   active. The timestamps of readADXL_sync are only exact to that
+ *   jitter (small compared to the 2.5 ms period at 400 Hz). At 400 Hz the
+ *   pulse keeps the MCU in EM0 for up to 2.4 % of the time.
+ *
+ * @return
+ *   @li true - ADXL_SYNC_BLOCK sets are ready to be read.
+ *   @li false - Nothing to do.
+ *****************************************************************************/
+bool triggerADXL_sync (void)
+{
+	if (syncPeriod == 0) return (false);
+
+	GPIO_PinOutSet(ADXL_INT2_PORT, ADXL_INT2_PIN);
+	uint32_t edge = RTC_CounterGet();
+
+	/* Next trigger, the counter wraps around at COMP0 */
+	uint32_t top = RTC_CompareGet(0);
+	uint32_t next = RTC_CompareGet(1) + syncPeriod;
+	if (next > top) next -= (top + 1);
+	RTC_CompareSet(1, next);
+
+	syncTriggers++;
+
+	/* The counter has to change one more time than ADXL_SYNC_PULSE (the edge can be at the end of a tick) */
+	while (ticksSinceADXL(edge) <= ADXL_SYNC_PULSE);
+
+	GPIO_PinOutClear(ADXL_INT2_PORT, ADXL_INT2_PIN);
+
+	return ((syncTriggers % ADXL_SYNC_BLOCK) == 0);
+}
+
+
+/**************************************************************************//**
+ * @brief
+ *   Read the synchronized samples from the FIFO.
+ *
+ * @param[out] samples
+ *   The buffer to put the decoded sample sets in.
+ *
+ * @param[in] maxSamples
+ *   The amount of sample sets that fit in the buffer.
+ *
+ * @param[out] timestamp
+ *   The RTC counter value of the first set (wrapped at COMP0 like the
+ *   counter), set k was taken k * getSyncPeriodADXL() ticks later.
+ *
+ * @return
+ *   The amount of sample sets put in the buffer.
+ *****************************************************************************/
+uint16_t readADXL_sync (ADXL_FifoSample_TypeDef *samples, uint16_t maxSamples, uint32_t *timestamp)
+{
+	*timestamp = syncNext;
+
+	uint16_t sets = readADXL_FIFO(samples, maxSamples);
+
+	/* The counter wraps around at COMP0 */
+	syncNext = (syncNext + ((uint32_t)sets * syncPeriod)) % (RTC_CompareGet(0) + 1);
+
+	return (sets);
+}
+
+
+/**************************************************************************//**
+ * @brief
+ *   Get the period of the synchronized sampling.
+ *
+ * @return
+ *   The period [RTC ticks] (0 if synchronized sampling isn't running).
+ *****************************************************************************/
+uint32_t getSyncPeriodADXL (void)
+{
+	return (syncPeriod);
+}
+
+
+/**************************************************************************//**
+ * @brief
+ *   Add a transaction to the queue without waiting for the SPI bus.
+ *
+ * @details
+ *   If the bus is idle the transaction is started right away, otherwise
+ *   it's started from the DMA interrupt handler when the previous one is
+ *   done. CS is handled by the transport, the callback (if any) is called
+ *   from the DMA interrupt handler after CS went high and the next
+ *   transaction was started. The callback is allowed to queue new
+ *   transactions but it can't wait for them.
+ *
+ * @note
+ *   The shadow is updated when a write is queued, so code that queues
+ *   register writes sees the new values right away.
+ *
+ * @param[in] transaction
+ *   The transaction, needs to stay valid until its "done" field is set.
+ *
+ * @param[in] caller
+ *   Only with ADXL_TRACE: the name of the calling method.
+ *
+ * @return
+ *   @li true - The transaction is queued.
+ *   @li false - The queue is full.
+ *****************************************************************************/
+#ifdef ADXL_TRACE /* ADXL_TRACE */
+bool queueADXL_traced (ADXL_Transaction_TypeDef *transaction, const char *caller)
+#else
+bool queueADXL (ADXL_Transaction_TypeDef *transaction)
+#endif /* ADXL_TRACE */
+{
+	return (enqueueADXL(transaction, ADXL_CALLER));
+}
+
+
+/**************************************************************************//**
+ * @brief
+ *   Add a transaction to the queue (see queueADXL).
+ *
+ * @details
+ *   The caller is passed along instead of being kept in a variable, so an
+ *   interrupt handler that queues in between can't take it.
+ *
+ * @param[in] transaction
+ *   The transaction, needs to stay valid until its "done" field is set.
+ *
+ * @param[in] caller
+ *   The name of the method to trace the transaction with (unused without
+ *   ADXL_TRACE).
+ *
+ * @return
+ *   @li true - The transaction is queued.
+ *   @li false - The queue is full.
+ *****************************************************************************/
+static bool enqueueADXL (ADXL_Transaction_TypeDef *transaction, const char *caller)
+{
+	CORE_DECLARE_IRQ_STATE;
+
+	if (transaction->length == 0)
+	{
+		transaction->done = true;
+		if (transaction->callback != NULL) transaction->callback(transaction);
+		return (true);
+	}
+
+	CORE_ENTER_ATOMIC();
+
+	if (queueCount == ADXL_QUEUE_SIZE)
+	{
+		CORE_EXIT_ATOMIC();
+		return (false);
+	}
+
+	/* The device is fixed when the transaction is queued */
+	ADXL_Device_TypeDef *device = (transaction->device != NULL) ? transaction->device : activeDevice;
+
+	transaction->done = false;
+	queue[(queueHead + queueCount) % ADXL_QUEUE_SIZE] = transaction;
+	queueDevice[(queueHead + queueCount) % ADXL_QUEUE_SIZE] = device;
+	queueCount++;
+
+	/* Keep the shadow coherent */
+	if (transaction->command == ADXL_CMD_WRITE_REG) updateShadowADXL(device, transaction->address, transaction->buffer, transaction->length);
+
+#ifdef ADXL_TRACE /* ADXL_TRACE */
+	traceADXL(transaction, caller);
+#else
+	(void) caller;
+#endif /* ADXL_TRACE */
+
+	/* Start right away if the bus is idle */
+	if (queueCount == 1) startTransactionADXL(transaction, device);
+
+	CORE_EXIT_ATOMIC();
+
+	return (true);
+}
+
+
+/**************************************************************************//**
+ * @brief
+ *   Integer square root (rounded down).
+ *
+ * @param[in] value
+ *   The value.
+ *
+ * @return
+ *   The square root.
+ *****************************************************************************/
+static uint16_t isqrtADXL (uint32_t value)
+{
+	uint32_t root = 0;
+	uint32_t bit = (uint32_t)1 << 30;
+
+	while (bit > value) bit >>= 2;
+
+	while (bit != 0)
+	{
+		if (value >= root + bit)
+		{
+			value -= root + bit;
+			root = (root >> 1) + bit;
+		}
+		else root >>= 1;
+
+		bit >>= 2;
+	}
+
+	return ((uint16_t)root);
+}
+
+
+/**************************************************************************//**
+ * @brief
+ *   Get the amount of RTC ticks since a given counter value.
+ *
+ * @param[in] start
+ *   The counter value to start from.
+ *
+ * @return
+ *   The amount of ticks (the counter wraps around at COMP0).
+ *****************************************************************************/
+static uint32_t ticksSinceADXL (uint32_t start)
+{
+	uint32_t now = RTC_CounterGet();
+
+	if (now >= start) return (now - start);
+	else return (now + RTC_CompareGet(0) + 1 - start);
+}
+
+
+/**************************************************************************//**
+ * @brief
+ *   Sleep in EM2 for a given time.
+ *
+ * @details
+ *   The queued transactions are finished first (USART0 and the DMA stop
+ *   in EM2). RTC compare channel 1 wakes the MCU up, other interrupts
+ *   don't end the sleep early. Synchronized sampling and the recovery
+ *   can't be going on (they use the same compare channel).
+ *
+ * @param[in] ticks
+ *   The amount of RTC ticks.
+ *****************************************************************************/
+static void sleepADXL_ticks (uint32_t ticks)
+{
+	waitQueueADXL();
+
+	uint32_t start = RTC_CounterGet();
+	scheduleWakeupADXL(ticks);
+
+	/* Disable interrupts so the compare can't fire between the check and sleeping */
+	__disable_irq();
+	while (ticksSinceADXL(start) < ticks)
+	{
+		EMU_EnterEM2(false);
+		__enable_irq();
+		__disable_irq();
+	}
+	__enable_irq();
+
+	RTC_IntDisable(RTC_IEN_COMP1);
+}
+
+
+#ifdef ADXL_TRACE /* ADXL_TRACE */
+/**************************************************************************//**
+ * @brief
+ *   Dump the SPI transaction trace and the counters per caller over UART.
+ *
+ * @details
+ *   The output is CSV (hexadecimal values), the caller is the name of the
+ *   method that called the transport (readADXL, updateADXL, queueADXL, ...),
+ *   for example "configADXL_ODR" for its updateADXL call:
+ *   @li T,timestamp,caller,command,address,length - One line per traced transaction (oldest first).
+ *   @li C,caller,transactions,bytes - One line per caller.
+ *   @li O,transactions - Transactions of callers that didn't fit in the table.
+ *****************************************************************************/
+void dumpADXL_trace (void)
+{
+
+#ifdef DEBUGGING /* DEBUGGING */
+	uint16_t count = (traceCount < ADXL_TRACE_SIZE) ? traceCount : ADXL_TRACE_SIZE;
+	uint16_t first = (traceNext + ADXL_TRACE_SIZE - count) % ADXL_TRACE_SIZE;
+
+	dbprintln("T,timestamp,caller,command,address,length");
+
+	for (uint16_t i = 0; i < count; i++)
+	{
+		const ADXL_Trace_TypeDef *entry = &trace[(first + i) % ADXL_TRACE_SIZE];
+
+		dbprint("T,");
+		dbprintInt_hex(entry->timestamp);
+		dbprint(",");
+		dbprint((char *)entry->caller);
+		dbprint(",");
+		dbprintInt_hex(entry->command);
+		dbprint(",");
+		dbprintInt_hex(entry->address);
+		dbprint(",");
+		dbprintlnInt_hex(entry->length);
+	}
+
+	dbprintln("C,caller,transactions,bytes");
+
+	for (uint8_t i = 0; (i < ADXL_TRACE_CALLERS) && (traceCallers[i].caller != NULL); i++)
+	{
+		dbprint("C,");
+		dbprint((char *)traceCallers[i].caller);
+		dbprint(",");
+		dbprintInt_hex(traceCallers[i].transactions);
+		dbprint(",");
+		dbprintlnInt_hex(traceCallers[i].bytes);
+	}
+
+	dbprint("O,");
+	dbprintlnInt_hex(traceOther);
+#endif /* DEBUGGING */
+
+}
+
+
+/**************************************************************************//**
+ * @brief
+ *   Clear the SPI transaction trace and the counters.
+ *****************************************************************************/
+void clearADXL_trace (void)
+{
+	CORE_DECLARE_IRQ_STATE;
+	CORE_ENTER_ATOMIC();
+
+	traceNext = 0;
+	traceCount = 0;
+	traceOther = 0;
+	for (uint8_t i = 0; i < ADXL_TRACE_CALLERS; i++) traceCallers[i].caller = NULL;
+
+	CORE_EXIT_ATOMIC();
+}
+#endif /* ADXL_TRACE */
+
+
+/**************************************************************************//**
+ * @brief
+ *   Add an accelerometer on its own CS pin to the SPI bus.
+ *
+ * @details
+ *   Every accelerometer has its own shadow and sample buffer, they share
+ *   USART0, the DMA channels, the transaction queue and VCC (so they're
+ *   all reset on a power cycle). The default accelerometer (ADXL_NCS_PIN)
+ *   is always there. Adding a device that's already there does nothing
+ *   (its shadow and sample buffer are kept).
+ *
+ * @param[out] device
+ *   The device handle (needs to stay valid).
+ *
+ * @param[in] csPort
+ *   The GPIO port of the CS pin.
+ *
+ * @param[in] csPin
+ *   The GPIO pin of the CS pin.
+ *
+ * @param[in] samples
+ *   The buffer for drainADXL_devices (can be NULL).
+ *
+ * @param[in] maxSets
+ *   The amount of sets that fit in the buffer.
+ *
+ * @return
+ *   @li true - The device is added (or was already added).
+ *   @li false - There are already ADXL_MAX_DEVICES devices.
+ *****************************************************************************/
+bool initADXL_device (ADXL_Device_TypeDef *device, GPIO_Port_TypeDef csPort, unsigned int csPin,
+		ADXL_FifoSample_TypeDef *samples, uint16_t maxSets)
+{
+	for (uint8_t i = 0; i < deviceCount; i++)
+	{
+		if (devicesADXL[i] == device) return (true);
+	}
+
+	if (deviceCount == ADXL_MAX_DEVICES) return (false);
+
+	device->csPort = csPort;
+	device->csPin = csPin;
+	device->samples = samples;
+	device->maxSets = (samples != NULL) ? maxSets : 0;
+	device->sets = 0;
+	resetShadowADXL(device);
+
+	GPIO_PinModeSet(csPort, csPin, gpioModePushPull, 1); /* CS is push pull */
+
+	devicesADXL[deviceCount] = device;
+	deviceCount++;
+
+#ifdef DEBUGGING /* DEBUGGING */
+	dbinfoInt("Accelerometer ", deviceCount, " added");
+#endif /* DEBUGGING */
+
+	return (true);
+}
+
+
+/**************************************************************************//**
+ * @brief
+ *   Select the accelerometer the other methods talk to.
+ *
+ * @details
+ *   Transactions that are already queued keep their device. The automatic
+ *   range switching, adaptive ODR, temperature compensation, calibration,
+ *   event capture, synchronized sampling and recovery keep their state
+ *   in one place, so they should be used with one device.
+ *
+ * @param[in] device
+ *   The device (NULL = the default accelerometer).
+ *****************************************************************************/
+void selectADXL (ADXL_Device_TypeDef *device)
+{
+	if (device == NULL) device = &defaultDevice;
+
+	activeDevice = device;
+	range = device->range;
+	oldRangeSets = 0;
+	autoRangeClip = false;
+}
+
+
+/**************************************************************************//**
+ * @brief
+ *   Get the selected accelerometer.
+ *
+ * @return
+ *   The device handle.
+ *****************************************************************************/
+ADXL_Device_TypeDef *getDeviceADXL (void)
+{
+	return (activeDevice);
+}
+
+
+/**************************************************************************//**
+ * @brief
+ *   Get the accelerometer on the default CS pin (ADXL_NCS_PIN).
+ *
+ * @return
+ *   The device handle (registered at startup, it can't be removed).
+ *****************************************************************************/
+ADXL_Device_TypeDef *getDefaultDeviceADXL (void)
+{
+	return (&defaultDevice);
+}
+
+
+/**************************************************************************//**
+ * @brief
+ *   Drain the FIFOs of a number of accelerometers back to back.
+ *
+ * @details
+ *   The FIFO_ENTRIES reads of all devices are queued at once, every
+ *   callback queues the FIFO read of its device so the bus is never idle
+ *   and everything is done in one wake window. The MCU waits in EM1, the
+ *   entries are decoded in the sample buffer of every device afterwards
+ *   ("sets" holds the amount of sets).
+ *
+ * @param[in] devices
+ *   The devices (with a sample buffer).
+ *
+ * @param[in] count
+ *   The amount of devices (max ADXL_MAX_DEVICES).
+ *****************************************************************************/
+void drainADXL_devices (ADXL_Device_TypeDef *const *devices, uint8_t count)
+{
+	if (count > ADXL_MAX_DEVICES) count = ADXL_MAX_DEVICES;
+
+	for (uint8_t i = 0; i < count; i++)
+	{
+		drainQueued[i] = true;
+		devices[i]->sets = 0;
+
+		/* Skip devices without a sample buffer */
+		drainCount[i].done = true;
+		if (devices[i]->maxSets == 0) continue;
+
+		drainCount[i].command = ADXL_CMD_READ_REG;
+		drainCount[i].address = ADXL_REG_FIFO_ENTRIES_L;
+		drainCount[i].buffer = drainEntries[i];
+		drainCount[i].length = 2;
+		drainCount[i].callback = &drainEntriesDoneADXL;
+		drainCount[i].user = NULL;
+		drainCount[i].device = devices[i];
+
+		/* Wait for room in the queue */
+		while (!queueADXL(&drainCount[i])) EMU_EnterEM1();
+	}
+
+	for (uint8_t i = 0; i < count; i++)
+	{
+		waitADXL(&drainCount[i]);
+
+		/* Queue the FIFO read if the callback couldn't */
+		if (!drainQueued[i]) while (!queueADXL(&drainFifo[i])) EMU_EnterEM1();
+	}
+
+	for (uint8_t i = 0; i < count; i++)
+	{
+		if (devices[i]->sets == 0) continue;
+
+		waitADXL(&drainFifo[i]);
+		devices[i]->sets = decodeFifoADXL(devices[i]->samples, devices[i]->sets, devices[i]);
+	}
+}
+
+
+/**************************************************************************//**
+ * @brief
+ *   Check if there are transactions queued or on the bus.
+ *
+ * @return
+ *   @li true - The SPI bus is in use.
+ *   @li false - The SPI bus is idle.
+ *****************************************************************************/
+bool queueBusyADXL (void)
+{
+	return (queueCount > 0);
+}
+
+
+/**************************************************************************//**
+ * @brief
+ *   Wait in EM1 until a queued transaction is done.
+ *
+ * @note
+ *   Interrupts are disabled while checking the flag so the completion
+ *   interrupt can't sneak in between the check and the WFI instruction
+ *   (a pending interrupt still wakes up the core). Don't call this
+ *   method from a callback!
+ *
+ * @param[in] transaction
+ *   The transaction to wait for.
+ *****************************************************************************/
+void waitADXL (ADXL_Transaction_TypeDef *transaction)
+{
+	__disable_irq();
+	while (!transaction->done)
+	{
+		EMU_EnterEM1();
+		__enable_irq();
+		__disable_irq();
+	}
+	__enable_irq();
+}
+
+
+/**************************************************************************//**
+ * @brief
+ *   Wait in EM1 until all queued transactions are done.
+ *
+ * @note
+ *   Necessary before the SPI pins are disabled and before going to EM2.
+ *****************************************************************************/
+void waitQueueADXL (void)
+{
+	__disable_irq();
+	while (queueCount > 0)
+	{
+		EMU_EnterEM1();
+		__enable_irq();
+		__disable_irq();
+	}
+	__enable_irq();
+}
+
+
+/**************************************************************************//**
+ * @brief
+ *   Perform an SPI transfer to or from the accelerometer and wait until
+ *   it's done.
+ *
+ * @details
+ *   The transfer is queued behind transactions that are already waiting
+ *   for the bus, so the order of all accesses is kept.
+ *
+ * @param[in] command
+ *   ADXL_CMD_READ_REG, ADXL_CMD_WRITE_REG or ADXL_CMD_READ_FIFO.
+ *
+ * @param[in] address
+ *   The address of the first register (not sent for ADXL_CMD_READ_FIFO).
+ *
+ * @param[in,out] buffer
+ *   The data to send (write) or the location to put the response (read).
+ *
+ * @param[in] length
+ *   The amount of data bytes.
+ *
+ * @param[in] caller
+ *   The name of the method that called the read/write method (ADXL_CALLER).
+ *****************************************************************************/
+static void transferADXL (uint8_t command, uint8_t address, uint8_t *buffer, uint16_t length, const char *caller)
+{
+	ADXL_Transaction_TypeDef transaction;
+
+	transaction.command = command;
+	transaction.address = address;
+	transaction.buffer = buffer;
+	transaction.length = length;
+	transaction.callback = NULL;
+	transaction.user = NULL;
+	transaction.device = NULL;
+
+	/* Wait for room in the queue */
+	while (!enqueueADXL(&transaction, caller)) EMU_EnterEM1();
+
+	waitADXL(&transaction);
+}
+
+
+/**************************************************************************//**
+ * @brief
+ *   Put a transaction on the bus.
+ *
+ * @details
+ *   The command and address are sent using polled transfers, after which
+ *   the DMA takes over the data bytes.
+ *
+ * @note
+ *   Called with interrupts disabled or from the DMA interrupt handler.
+ *
+ * @param[in] transaction
+ *   The transaction to start.
+ *
+ * @param[in] device
+ *   The accelerometer to select (CS).
+ *****************************************************************************/
+static void startTransactionADXL (ADXL_Transaction_TypeDef *transaction, ADXL_Device_TypeDef *device)
+{
+	dmaBuffer = transaction->buffer;
+	dmaRemaining = transaction->length;
+	dmaRead = (transaction->command != ADXL_CMD_WRITE_REG);
+
+	/* Set CS low (active low!) */
+	GPIO_PinOutClear(device->csPort, device->csPin);
+
+	USART_SpiTransfer(USART0, transaction->command); /* Instruction */
+	if (transaction->command != ADXL_CMD_READ_FIFO) USART_SpiTransfer(USART0, transaction->address); /* Address */
+
+	/* Make sure no old data gets picked up by the RX channel */
+	USART0->CMD = USART_CMD_CLEARRX;
+
+	startDMA_ADXL();
+}
+
+
+/**************************************************************************//**
+ * @brief
+ *   Start the next DMA cycle of the current transfer.
+ *
+ * @details
+ *   A DMA cycle can only move ADXL_DMA_MAX_TRANSFERS bytes, longer
+ *   transfers are split up while keeping CS low. The RX channel is
+ *   activated first so no received byte can be missed.
+ *****************************************************************************/
+static void startDMA_ADXL (void)
+{
+	uint16_t count = (dmaRemaining > ADXL_DMA_MAX_TRANSFERS) ? ADXL_DMA_MAX_TRANSFERS : dmaRemaining;
+
+	DMA_CfgDescr_TypeDef rxDescr;
+	rxDescr.dstInc = dmaRead ? dmaDataInc1 : dmaDataIncNone;
+	rxDescr.srcInc = dmaDataIncNone;
+	rxDescr.size = dmaDataSize1;
+	rxDescr.arbRate = dmaArbitrate1;
+	rxDescr.hprot = 0;
+	DMA_CfgDescr(ADXL_DMA_CH_RX, true, &rxDescr);
+
+	DMA_CfgDescr_TypeDef txDescr;
+	txDescr.dstInc = dmaDataIncNone;
+	txDescr.srcInc = dmaRead ? dmaDataIncNone : dmaDataInc1;
+	txDescr.size = dmaDataSize1;
+	txDescr.arbRate = dmaArbitrate1;
+	txDescr.hprot = 0;
+	DMA_CfgDescr(ADXL_DMA_CH_TX, true, &txDescr);
+
+	DMA_ActivateBasic(ADXL_DMA_CH_RX, true, false,
+			(dmaRead ? dmaBuffer : &dmaDummyRX), (void *)&(USART0->RXDATA), count - 1);
+	DMA_ActivateBasic(ADXL_DMA_CH_TX, true, false,
+			(void *)&(USART0->TXDATA), (dmaRead ? &dmaDummyTX : dmaBuffer), count - 1);
+
+	dmaBuffer += count;
+	dmaRemaining -= count;
+}
+
+
+/**************************************************************************//**
+ * @brief
+ *   DMA callback function, called when the RX channel is done.
+ *
+ * @details
+ *   Starts the next DMA cycle if the transfer isn't complete yet,
+ *   otherwise CS is set high, the next queued transaction is started
+ *   and the callback of the finished one is called.
+ *
+ * @note
+ *   This method is called from the DMA interrupt handler (located in "em_dma.c").
+ *****************************************************************************/
+static void transferDoneADXL (unsigned int channel, bool primary, void *user)
+{
+	(void) channel;
+	(void) primary;
+	(void) user;
+
+	if (dmaRemaining > 0)
+	{
+		startDMA_ADXL();
+		return;
+	}
+
+	/* Set CS high */
+	GPIO_PinOutSet(queueDevice[queueHead]->csPort, queueDevice[queueHead]->csPin);
+
+	/* Remove the finished transaction from the queue */
+	ADXL_Transaction_TypeDef *transaction = queue[queueHead];
+	queueHead = (queueHead + 1) % ADXL_QUEUE_SIZE;
+	queueCount--;
+
+	/* Keep the bus busy */
+	if (queueCount > 0) startTransactionADXL(queue[queueHead], queueDevice[queueHead]);
+
+	transaction->done = true;
+	if (transaction->callback != NULL) transaction->callback(transaction);
+}
+
+
+/**************************************************************************//**
+ * @brief
+ *   Put written bytes that belong to shadowed registers in the shadow.
+ *
+ * @details
+ *   A soft reset command puts the shadow back at the reset values.
+ *   Writes to FILTER_CTL also update the range of the device (and the
+ *   global range variable if it's the selected device).
+ *
+ * @param[in] device
+ *   The accelerometer that was written to.
+ *
+ * @param[in] address
+ *   The address of the first written register.
+ *
+ * @param[in] buffer
+ *   The written data.
+ *
+ * @param[in] length
+ *   The amount of written bytes.
+ *****************************************************************************/
+static void updateShadowADXL (ADXL_Device_TypeDef *device, uint8_t address, const uint8_t *buffer, uint16_t length)
+{
+	for (uint16_t i = 0; i < length; i++)
+	{
+		uint16_t reg = address + i;
+
+		if ((reg == ADXL_REG_SOFT_RESET) && (buffer[i] == 0x52)) resetShadowADXL(device);
+		else if ((reg > ADXL_SHADOW_FIRST) && (reg <= ADXL_SHADOW_LAST)) device->shadow[reg - ADXL_SHADOW_FIRST] = buffer[i];
+
+		/* Keep the range variables in line with the shadow */
+		if (reg == ADXL_REG_FILTER_CTL)
+		{
+			device->range = ((buffer[i] >> 6) > 2) ? 2 : (buffer[i] >> 6);
+			if (device == activeDevice) range = device->range;
+		}
+	}
+}
+
+
+/**************************************************************************//**
+ * @brief
+ *   Configure the Output Data Rate (ODR).
+ *
+ * @param[in] givenODR
+ *   @li 0 - 12.5 Hz
+ *   @li 1 - 25 Hz
+ *   @li 2 - 50 Hz
+ *   @li 3 - 100 Hz (reset default)
+ *   @li 4 - 200 Hz
+ *   @li 5 - 400 Hz
+ *****************************************************************************/
+void configADXL_ODR (uint8_t givenODR)
+{
+	/* Unknown settings fall back to the reset default */
+	uint8_t odr = (givenODR > 5) ? 3 : givenODR;
+
+	/* Set ODR (last three bits), the other bits come from the shadow */
+	updateADXL(ADXL_REG_FILTER_CTL, 0b00000111, odr);
+
+#ifdef DEBUGGING /* DEBUGGING */
+	if (givenODR == 0) dbinfo("ODR set at 12.5 Hz");
+	else if (givenODR == 1) dbinfo("ODR set at 25 Hz");
+	else if (givenODR == 2) dbinfo("ODR set at 50 Hz");
+	else if (givenODR == 3) dbinfo("ODR set at 100 Hz");
+	else if (givenODR == 4) dbinfo("ODR set at 200 Hz");
+	else if (givenODR == 5) dbinfo("ODR set at 400 Hz");
+	else dbinfo("ODR set at 100 Hz (reset default)");
+#endif /* DEBUGGING */
+
+}
+
+
+/**************************************************************************//**
+ * @brief
+ *   Enable or disable the adaptive ODR controller.
+ *
+ * @details
+ *   The controller starts at 12.5 Hz (lowest current). adaptADXL_ODR
+ *   goes up one step when the signal energy of a batch is above
+ *   ADXL_ODR_ENERGY_UP, activityADXL_ODR does the same for an activity
+ *   interrupt. After quietTime ms of batches below ADXL_ODR_ENERGY_QUIET
+ *   the ODR drops back to 12.5 Hz. The highest ODR used is the lowest
+ *   one with a bandwidth (ODR/4 with HALF_BW, ODR/2 without) that meets
+ *   the target.
+ *
+ * @param[in] bandwidth
+ *   The bandwidth target [Hz] (0 disables the controller).
+ *
+ * @param[in] quietTime
+ *   Time without signal energy before dropping back to 12.5 Hz [ms].
+ *****************************************************************************/
+void configADXL_adaptiveODR (uint16_t bandwidth, uint16_t quietTime)
+{
+	if (bandwidth == 0)
+	{
+		odrMax = 0xFF;
+
+#ifdef DEBUGGING /* DEBUGGING */
+		dbinfo("Adaptive ODR disabled");
+#endif /* DEBUGGING */
+
+		return;
+	}
+
+	/* Bandwidth [Hz] = 12.5 Hz * 2^odr / (4 or 2) */
+	uint8_t divider = (getShadowADXL(ADXL_REG_FILTER_CTL) & 0b00010000) ? 8 : 4;
+	odrMax = 0;
+	while ((odrMax < 5) && (((25 << odrMax) / divider) < bandwidth)) odrMax++;
+
+	odrQuietTime = quietTime;
+	odrQuiet = 0;
+
+	switchODR_ADXL(0, ADXL_ODR_REASON_QUIET);
+
+#ifdef DEBUGGING /* DEBUGGING */
+	dbinfoInt("Adaptive ODR enabled, highest setting: ", odrMax, "");
+#endif /* DEBUGGING */
+
+}
+
+
+/**************************************************************************//**
+ * @brief
+ *   Adapt the ODR to the signal energy of a batch of sample sets.
+ *
+ * @details
+ *   The signal energy is the mean absolute deviation from the mean of
+ *   the batch (summed over the axes, in mg), so gravity and offsets
+ *   don't count and the result doesn't depend on the ODR.
+ *
+ * @param[in] samples
+ *   The sample sets read from the FIFO (all measured at the current ODR).
+ *
+ * @param[in] sets
+ *   The amount of sample sets.
+ *****************************************************************************/
+void adaptADXL_ODR (const ADXL_FifoSample_TypeDef *samples, uint16_t sets)
+{
+	if ((odrMax == 0xFF) || (sets == 0) || (getSyncPeriodADXL() != 0)) return;
+
+	int32_t mean[3] = { 0, 0, 0 };
+	uint32_t energy = 0;
+
+	for (uint16_t i = 0; i < sets; i++)
+	{
+		mean[0] += samples[i].x;
+		mean[1] += samples[i].y;
+		mean[2] += samples[i].z;
+	}
+
+	mean[0] /= sets;
+	mean[1] /= sets;
+	mean[2] /= sets;
+
+	for (uint16_t i = 0; i < sets; i++)
+	{
+		int32_t dx = samples[i].x - mean[0];
+		int32_t dy = samples[i].y - mean[1];
+		int32_t dz = samples[i].z - mean[2];
+
+		/* Codes to mg (1, 2 or 4 mg/LSB) */
+		energy += (((dx < 0) ? -dx : dx) + ((dy < 0) ? -dy : dy) + ((dz < 0) ? -dz : dz)) << samples[i].range;
+	}
+
+	energy /= sets;
+
+	uint8_t odr = getShadowADXL(ADXL_REG_FILTER_CTL) & 0b00000111;
+
+	if (energy > ADXL_ODR_ENERGY_UP)
+	{
+		odrQuiet = 0;
+		if (odr < odrMax) switchODR_ADXL(odr + 1, ADXL_ODR_REASON_ENERGY);
+	}
+	else if (energy < ADXL_ODR_ENERGY_QUIET)
+	{
+		/* Duration of the batch: 80 ms per set at 12.5 Hz */
+		odrQuiet += ((uint32_t)sets * 80) >> odr;
+
+		if ((odr > 0) && (odrQuiet >= odrQuietTime))
+		{
+			odrQuiet = 0;
+			switchODR_ADXL(0, ADXL_ODR_REASON_QUIET);
+		}
+	}
+	else odrQuiet = 0;
+}
+
+
+/**************************************************************************//**
+ * @brief
+ *   Let the adaptive ODR controller know an activity interrupt happened.
+ *****************************************************************************/
+void activityADXL_ODR (void)
+{
+	if ((odrMax == 0xFF) || (getSyncPeriodADXL() != 0)) return;
+
+	uint8_t odr = getShadowADXL(ADXL_REG_FILTER_CTL) & 0b00000111;
+
+	odrQuiet = 0;
+	if (odr < odrMax) switchODR_ADXL(odr + 1, ADXL_ODR_REASON_ACTIVITY);
+}
+
+
+/**************************************************************************//**
+ * @brief
+ *   Get the logged ODR transitions of the adaptive ODR controller.
+ *
+ * @param[out] log
+ *   The buffer to put the transitions in (oldest first).
+ *
+ * @param[in] maxEntries
+ *   The amount of transitions that fit in the buffer.
+ *
+ * @return
+ *   The amount of transitions put in the buffer.
+ *****************************************************************************/
+uint8_t getODRlogADXL (ADXL_ODRLog_TypeDef *log, uint8_t maxEntries)
+{
+	uint8_t count = (odrLogCount < maxEntries) ? odrLogCount : maxEntries;
+	uint8_t first = (odrLogNext + ADXL_ODR_LOG_SIZE - odrLogCount) % ADXL_ODR_LOG_SIZE;
+
+	for (uint8_t i = 0; i < count; i++) log[i] = odrLog[(first + i) % ADXL_ODR_LOG_SIZE];
+
+	return (count);
+}
+
+
+/**************************************************************************//**
+ * @brief
+ *   Configure the measurement range and store the selected one in
+ *   a global variable.
+ *
+ * @param[in] givenRange
+ *   @li 0 - +- 2g
+ *   @li 1 - +- 4g
+ *   @li 2 - +- 8g
+ *****************************************************************************/
+void configADXL_range (uint8_t givenRange)
+{
+	/* Set measurement range (first two bits), the other bits come from the shadow */
+	if (givenRange == 0) {
+		updateADXL(ADXL_REG_FILTER_CTL, 0b11000000, 0b00000000);
+		range = 0;
+	}
+	else if (givenRange == 1) {
+		updateADXL(ADXL_REG_FILTER_CTL, 0b11000000, 0b01000000);
+		range = 1;
+	}
+	else if (givenRange == 2) {
+		updateADXL(ADXL_REG_FILTER_CTL, 0b11000000, 0b10000000);
+		range = 2;
+	}
+
+#ifdef DEBUGGING /* DEBUGGING */
+	if (range == 0) dbinfo("Measurement mode +- 2g selected");
+	else if (range == 1) dbinfo("Measurement mode +- 4g selected");
+	else if (range == 2) dbinfo("Measurement mode +- 8g selected");
+#endif /* DEBUGGING */
+
+}
+
+
+/**************************************************************************//**
+ * @brief
+ *   Enable or disable automatic range switching.
+ *
+ * @details
+ *   When enabled, autoRangeADXL switches to a larger range as soon as a
+ *   value comes close to full scale and back to a smaller range after
+ *   ADXL_AUTORANGE_CALM sets with low values. The gap between
+ *   ADXL_AUTORANGE_LOW and ADXL_AUTORANGE_CLIP (after doubling) is the
+ *   hysteresis.
+ *
+ * @param[in] enabled
+ *   @li True - Enable automatic range switching.
+ *   @li False - Keep the current range.
+ *****************************************************************************/
+void configADXL_autoRange (bool enabled)
+{
+	autoRange = enabled;
+	autoRangeCalm = 0;
+	autoRangeClip = false;
+
+#ifdef DEBUGGING /* DEBUGGING */
+	if (enabled) dbinfo("Automatic range switching enabled");
+	else dbinfo("Automatic range switching disabled");
+#endif /* DEBUGGING */
+
+}
+
+
+/**************************************************************************//**
+ * @brief
+ *   Check sample sets and switch the range if necessary.
+ *
+ * @details
+ *   Every set is checked for clipping in the range it was measured in, so
+ *   a clip during the transition of a switch isn't lost. A clip that
+ *   can't be handled yet (sets of the previous switch are still in the
+ *   FIFO) is remembered and handled as soon as those sets are read. Sets
+ *   measured in another range don't count for the calm period.
+ *
+ * @param[in] samples
+ *   The sample sets (with range tags) read from the FIFO.
+ *
+ * @param[in] sets
+ *   The amount of sample sets.
+ *****************************************************************************/
+void autoRangeADXL (const ADXL_FifoSample_TypeDef *samples, uint16_t sets)
+{
+	if (!autoRange) return;
+
+	/* Clip of an earlier call that had to wait for the previous switch */
+	if (autoRangeClip && (oldRangeSets == 0))
+	{
+		autoRangeClip = false;
+		if (range < 2) switchRangeADXL(range + 1);
+	}
+
+	for (uint16_t i = 0; i < sets; i++)
+	{
+		/* Sets of a smaller range than the current one are already handled */
+		if (samples[i].range < range) continue;
+
+		/* Largest absolute value of the set */
+		int16_t peak = (samples[i].x < 0) ? -samples[i].x : samples[i].x;
+		int16_t y = (samples[i].y < 0) ? -samples[i].y : samples[i].y;
+		int16_t z = (samples[i].z < 0) ? -samples[i].z : samples[i].z;
+		if (y > peak) peak = y;
+		if (z > peak) peak = z;
+
+		/* (Close to) clipping: next range immediately */
+		if (peak >= ADXL_AUTORANGE_CLIP)
+		{
+			autoRangeCalm = 0;
+			if ((range < 2) && !switchRangeADXL(range + 1) && (oldRangeSets != 0)) autoRangeClip = true;
+			return;
+		}
+
+		if (samples[i].range != range) continue;
+
+		if (peak < ADXL_AUTORANGE_LOW) autoRangeCalm++;
+		else autoRangeCalm = 0;
+	}
+
+	/* Calm for long enough: previous range for a finer resolution */
+	if ((autoRangeCalm >= ADXL_AUTORANGE_CALM) && (range > 0))
+	{
+		autoRangeCalm = 0;
+		switchRangeADXL(range - 1);
+	}
+}
+
+
+/**************************************************************************//**
+ * @brief
+ *   Configure the accelerometer to work in activity threshold mode.
+ *
+ * @details
+ *   Wrapper around configADXL_activity_mg.
+ *
+ * @param[in] gThreshold
+ *   Threshold [g].
+ *****************************************************************************/
+void configADXL_activity (uint8_t gThreshold)
+{
+	/* More than 16 g doesn't fit in the threshold registers in any range */
+	configADXL_activity_mg((gThreshold > 16) ? 16000 : (gThreshold * 1000));
+}
+
+
+/**************************************************************************//**
+ * @brief
+ *   Configure the accelerometer to work in activity threshold mode.
+ *
+ * @details
+ *   Route activity detector to INT1 pin using INTMAP1, isolate bits
+ *   and write settings to both threshold registers. The link mode and
+ *   inactivity settings in ACT_INACT_CTL are kept.
+ *
+ * @param[in] mgThreshold
+ *   Threshold [mg], limited to what fits in 11 bits for the current range.
+ *****************************************************************************/
+void configADXL_activity_mg (uint16_t mgThreshold)
+{
+	/* Map activity detector to INT1 pin  */
+	updateADXL(ADXL_REG_INTMAP1, 0b00010000, 0b00010000); /* Bit 4 selects activity detector */
+
+	/* Enable referenced activity threshold mode (last two bits) */
+	updateADXL(ADXL_REG_ACT_INACT_CTL, 0b00000011, 0b00000011);
+
+	/* Convert mg value to "codes" (1 mg/LSB at +-2g, 2 mg/LSB at +-4g, 4 mg/LSB at +-8g) */
+	uint16_t threshold = mgThreshold >> range;
+	if (threshold > 0x7FF) threshold = 0x7FF;
+
+	/* Isolate bits using masks and shifting (total: 11bit unsigned) */
+	uint8_t thresh[2];
+	thresh[0] = (threshold & 0b00011111111);      /* 7:0 bits used */
+	thresh[1] = (threshold & 0b11100000000) >> 8; /* 2:0 bits used */
+
+	/* Set both threshold registers in one burst */
+	burstWriteADXL(ADXL_REG_THRESH_ACT_L, thresh, 2);
+
+#ifdef DEBUGGING /* DEBUGGING */
+	dbinfoInt("Activity configured: ", mgThreshold, " mg");
+#endif /* DEBUGGING */
+
+}
+
+
+/**************************************************************************//**
+ * @brief
+ *   Set the activity and inactivity thresholds using the noise floor.
+ *
+ * @details
+ *   Every new sample during the window (DATA_READY bit in STATUS, read in
+ *   one burst with X-Y-Z-TEMP) is used to calculate the standard deviation
+ *   of every axis. The activity threshold is actFactor times the noisiest
+ *   axis (activity = one axis above it), the inactivity threshold is
+ *   inactFactor times the same noise (inactivity = all axes below it).
+ *   Both detectors are referenced, so the gravity doesn't matter. The
+ *   inactivity time in the shadow is kept.
+ *
+ * @note
+ *   The accelerometer needs to be in measurement (or wake-up) mode and the
+ *   board shouldn't move during the window.
+ *
+ * @param[in] actFactor
+ *   Activity threshold = actFactor x noise.
+ *
+ * @param[in] inactFactor
+ *   Inactivity threshold = inactFactor x noise (0 = don't change it).
+ *
+ * @param[in] window
+ *   Duration of the measurement [ms].
+ *
+ * @param[out] result
+ *   The noise per axis and the thresholds that were written.
+ *
+ * @return
+ *   @li true - The thresholds are written.
+ *   @li false - Not in measurement mode or less than ADXL_TUNE_MIN_SAMPLES
+ *       samples in the window, nothing is written.
+ *****************************************************************************/
+bool tuneADXL_thresholds (uint8_t actFactor, uint8_t inactFactor, uint16_t window, ADXL_NoiseFloor_TypeDef *result)
+{
+	int32_t sum[3] = { 0, 0, 0 };
+	uint64_t squares[3] = { 0, 0, 0 };
+	uint8_t buffer[11]; /* STATUS, FIFO_ENTRIES_L/H, X-Y-Z-TEMP */
+	uint32_t start = msTicks;
+	uint16_t n = 0;
+
+	result->samples = 0;
+
+	if ((getShadowADXL(ADXL_REG_POWER_CTL) & 0b00000011) != 0b00000010) return (false);
+
+	while ((msTicks - start) < window)
+	{
+		burstReadADXL(ADXL_REG_STATUS, buffer, 11);
+
+		/* Only count new samples (reading the data clears DATA_READY) */
+		if (!(buffer[0] & 0b00000001))
+		{
+			Delay(1);
+			continue;
+		}
+
+		for (uint8_t axis = 0; axis < 3; axis++)
+		{
+			int16_t value = (int16_t)((buffer[4 + (axis * 2)] << 8) | buffer[3 + (axis * 2)]);
+
+			sum[axis] += value;
+			squares[axis] += (int32_t)value * value;
+		}
+
+		if (++n == UINT16_MAX) break;
+	}
+
+	result->samples = n;
+	if (n < ADXL_TUNE_MIN_SAMPLES) return (false);
+
+	uint16_t noise = 0;
+
+	for (uint8_t axis = 0; axis < 3; axis++)
+	{
+		/* Variance = (n * sum(x^2) - sum(x)^2) / n^2 [codes^2] */
+		uint64_t variance = ((n * squares[axis]) - ((int64_t)sum[axis] * sum[axis])) / ((uint32_t)n * n);
+
+		/* Codes to mg (1, 2 or 4 mg/LSB) */
+		result->noise[axis] = isqrtADXL((variance > UINT32_MAX) ? UINT32_MAX : (uint32_t)variance) << range;
+
+		if (result->noise[axis] > noise) noise = result->noise[axis];
+	}
+
+	/* At least one code */
+	if (noise < (1 << range)) noise = (1 << range);
+
+	result->actThreshold = ((uint32_t)noise * actFactor > UINT16_MAX) ? UINT16_MAX : (noise * actFactor);
+	configADXL_activity_mg(result->actThreshold);
+
+	if (inactFactor > 0)
+	{
+		uint16_t time = getShadowADXL(ADXL_REG_TIME_INACT_L) | (getShadowADXL(ADXL_REG_TIME_INACT_H) << 8);
+
+		result->inactThreshold = ((uint32_t)noise * inactFactor > UINT16_MAX) ? UINT16_MAX : (noise * inactFactor);
+		configADXL_inactivity(result->inactThreshold, time);
+	}
+	else result->inactThreshold = 0;
+
+#ifdef DEBUGGING /* DEBUGGING */
+	dbinfoInt("Noise floor X: ", result->noise[0], " mg");
+	dbinfoInt("Noise floor Y: ", result->noise[1], " mg");
+	dbinfoInt("Noise floor Z: ", result->noise[2], " mg");
+	dbinfoInt("Samples in the window: ", n, "");
+#endif /* DEBUGGING */
+
+	return (true);
+}
+
+
+/**************************************************************************//**
+ * @brief
+ *   Configure the activity timer.
+ *
+ * @note
+ *   The activity timer isn't available in wake-up mode.
+ *
+ * @param[in] time
+ *   Amount of consecutive samples above the activity threshold before
+ *   activity is detected (0 = one sample is enough).
+ *****************************************************************************/
+void configADXL_activityTime (uint8_t time)
+{
+	updateADXL(ADXL_REG_TIME_ACT, 0xFF, time);
+
+#ifdef DEBUGGING /* DEBUGGING */
+	dbinfoInt("Activity time: ", time, " samples");
+#endif /* DEBUGGING */
+
+}
+
+
+/**************************************************************************//**
+ * @brief
+ *   Configure and enable referenced inactivity detection.
+ *
+ * @details
+ *   THRESH_INACT_L up to TIME_INACT_H are written in one burst.
+ *
+ * @param[in] mgThreshold
+ *   Threshold [mg], inactivity is detected when all axes stay below it.
+ *
+ * @param[in] time
+ *   Amount of consecutive samples below the threshold before
+ *   inactivity is detected.
+ *****************************************************************************/
+void configADXL_inactivity (uint16_t mgThreshold, uint16_t time)
+{
+	/* Convert mg value to "codes" (1 mg/LSB at +-2g, 2 mg/LSB at +-4g, 4 mg/LSB at +-8g) */
+	uint16_t threshold = mgThreshold >> range;
+	if (threshold > 0x7FF) threshold = 0x7FF;
+
+	uint8_t inact[4];
+	inact[0] = (threshold & 0b00011111111);      /* THRESH_INACT_L: 7:0 bits used */
+	inact[1] = (threshold & 0b11100000000) >> 8; /* THRESH_INACT_H: 2:0 bits used */
+	inact[2] = (time & 0xFF);                    /* TIME_INACT_L */
+	inact[3] = (time >> 8);                      /* TIME_INACT_H */
+
+	burstWriteADXL(ADXL_REG_THRESH_INACT_L, inact, 4);
+
+	/* Enable referenced inactivity detection (bits 3:2) */
+	updateADXL(ADXL_REG_ACT_INACT_CTL, 0b00001100, 0b00001100);
+
+#ifdef DEBUGGING /* DEBUGGING */
+	dbinfoInt("Inactivity configured: ", mgThreshold, " mg");
+#endif /* DEBUGGING */
+
+}
+
+
+/**************************************************************************//**
+ * @brief
+ *   Configure the link mode of the activity and inactivity detectors.
+ *
+ * @details
+ *   In loop mode the accelerometer looks for inactivity after activity
+ *   was detected (and the other way around) and re-arms itself, the
+ *   interrupts don't need to be acknowledged by reading STATUS.
+ *
+ * @param[in] mode
+ *   @li ADXL_LINK_DEFAULT - Default mode.
+ *   @li ADXL_LINK_LINKED - Linked mode.
+ *   @li ADXL_LINK_LOOP - Loop mode.
+ *****************************************************************************/
+void configADXL_link (uint8_t mode)
+{
+	updateADXL(ADXL_REG_ACT_INACT_CTL, 0b00110000, (mode << 4));
+
+#ifdef DEBUGGING /* DEBUGGING */
+	if (mode == ADXL_LINK_DEFAULT) dbinfo("Activity/inactivity in default mode");
+	else if (mode == ADXL_LINK_LINKED) dbinfo("Activity/inactivity in linked mode");
+	else if (mode == ADXL_LINK_LOOP) dbinfo("Activity/inactivity in loop mode");
+#endif /* DEBUGGING */
+
+}
+
+
+/**************************************************************************//**
+ * @brief
+ *   Acknowledge an activity/inactivity interrupt.
+ *
+ * @details
+ *   In loop mode nothing needs to happen. Otherwise a STATUS read is
+ *   queued, the method doesn't wait for it.
+ *****************************************************************************/
+void acknowledgeADXL (void)
+{
+	if ((getShadowADXL(ADXL_REG_ACT_INACT_CTL) & 0b00110000) == (ADXL_LINK_LOOP << 4)) return;
+
+	/* Don't queue the same descriptor twice */
+	if (ackRead.done) queueADXL(&ackRead);
+}
+
+/**************************************************************************//**
+ * @brief
+ *   Write the complete boot configuration to the accelerometer.
+ *
+ * @details
+ *   The register image is built at compile time using the ADXL_CFG_
+ *   settings in "accel.h" and written in one auto-incrementing burst
+ *   (THRESH_ACT_L up to POWER_CTL). This replaces separate calls to
+ *   configADXL_range, configADXL_ODR, configADXL_activity,
+ *   configADXL_FIFO and measureADXL.
+ *****************************************************************************/
+void configADXL_boot (void)
+{
+	/* Burst write (address auto-increments), also updates the shadow and range */
+	burstWriteADXL(ADXL_BOOT_FIRST, bootConfigADXL, ADXL_BOOT_SIZE);
+
+#ifdef DEBUGGING /* DEBUGGING */
+	dbinfoInt("Boot configuration written (", ADXL_BOOT_SIZE, " registers)");
+#endif /* DEBUGGING */
+
+}
+
+
+/**************************************************************************//**
+ * @brief
+ *   Switch to a power/noise profile.
+ *
+ * @details
+ *   FILTER_CTL and POWER_CTL are neighbours, so the LOW_NOISE bits, HALF_BW
+ *   and the ODR are changed in one burst write. The range, EXT_SAMPLE and
+ *   the power state (measurement, wake-up, autosleep) are kept.
+ *
+ * @param[in] profile
+ *   The profile to use.
+ *****************************************************************************/
+void setProfileADXL (ADXL_Profile_TypeDef profile)
+{
+	if (profile >= ADXL_PROFILES) return;
+
+	const ADXL_ProfileInfo_TypeDef *info = &profilesADXL[profile];
+	uint8_t regs[2];
+
+	/* FILTER_CTL: HALF_BW (bit 4) - ODR (bits 2:0) */
+	regs[0] = (getShadowADXL(ADXL_REG_FILTER_CTL) & 0b11101000) | (info->halfBW << 4) | info->odr;
+
+	/* POWER_CTL: LOW_NOISE (bits 5:4) */
+	regs[1] = (getShadowADXL(ADXL_REG_POWER_CTL) & 0b11001111) | (info->lowNoise << 4);
+
+	/* Burst write (address auto-increments), also updates the shadow */
+	burstWriteADXL(ADXL_REG_FILTER_CTL, regs, 2);
+
+#ifdef DEBUGGING /* DEBUGGING */
+	dbinfo("Profile:");
+	dbprintln((char *)info->name);
+#endif /* DEBUGGING */
+
+}
+
+
+/**************************************************************************//**
+ * @brief
+ *   Get the power/noise profile that matches the current settings.
+ *
+ * @return
+ *   The profile, or ADXL_PROFILES if the settings don't match a profile
+ *   (changed by configADXL_ODR for example).
+ *****************************************************************************/
+ADXL_Profile_TypeDef getProfileADXL (void)
+{
+	uint8_t filter = getShadowADXL(ADXL_REG_FILTER_CTL);
+	uint8_t power = getShadowADXL(ADXL_REG_POWER_CTL);
+
+	for (uint8_t i = 0; i < ADXL_PROFILES; i++)
+	{
+		if ((((filter >> 4) & 0b1) == profilesADXL[i].halfBW) &&
+			((filter & 0b111) == profilesADXL[i].odr) &&
+			(((power >> 4) & 0b11) == profilesADXL[i].lowNoise)) return ((ADXL_Profile_TypeDef) i);
+	}
+
+	return (ADXL_PROFILES);
+}
+
+
+/**************************************************************************//**
+ * @brief
+ *   Get the register settings and expected current and noise of a profile.
+ *
+ * @param[in] profile
+ *   The profile.
+ *
+ * @return
+ *   The profile information, NULL if the profile doesn't exist.
+ *****************************************************************************/
+const ADXL_ProfileInfo_TypeDef *getProfileInfoADXL (ADXL_Profile_TypeDef profile)
+{
+	if (profile >= ADXL_PROFILES) return (NULL);
+
+	return (&profilesADXL[profile]);
+}
+
+
+/**************************************************************************//**
+ * @brief
+ *   Enable or disable measurement mode.
+ *
+ * @param[in] enabled
+ *   @li True - Enable measurement mode.
+ *   @li False - Disable measurement mode (standby).
+ *****************************************************************************/
+void measureADXL (bool enabled)
+{
+	if (enabled)
+	{
+		/* Enable measurements */
+		updateADXL(ADXL_REG_POWER_CTL, 0b00000011, 0b00000010); /* Last 2 bits are measurement mode */
+
+#ifdef DEBUGGING /* DEBUGGING */
+		dbinfo("Measurement enabled");
+#endif /* DEBUGGING */
+
+	}
+	else
+	{
+		/* Disable measurements */
+		updateADXL(ADXL_REG_POWER_CTL, 0b00000011, 0b00000000); /* Last 2 bits are measurement mode */
+
+#ifdef DEBUGGING /* DEBUGGING */
+		dbinfo("Measurement disabled (standby)");
+#endif /* DEBUGGING */
+
+	}
+}
+
+
+/**************************************************************************//**
+ * @brief
+ *   Move the accelerometer to another power state.
+ *
+ * @details
+ *   POWER_CTL (and ACT_INACT_CTL for autosleep) is changed using the
+ *   shadow. Autosleep needs linked or loop mode, so loop mode and the
+ *   referenced inactivity detector are enabled on entry and the previous
+ *   ACT_INACT_CTL value is restored on exit. The activity detector (and
+ *   with that INT1) is kept enabled in every state except standby.
+ *   The inactivity threshold and time come from the boot configuration.
+ *
+ * @param[in] state
+ *   @li ADXL_STATE_STANDBY - Standby.
+ *   @li ADXL_STATE_MEASURE - Measurement mode.
+ *   @li ADXL_STATE_WAKEUP - Wake-up mode.
+ *   @li ADXL_STATE_AUTOSLEEP - Measurement mode with autosleep (loop mode).
+ *****************************************************************************/
+void setPowerStateADXL (ADXL_PowerState_TypeDef state)
+{
+	ADXL_PowerState_TypeDef old = getPowerStateADXL();
+
+	if (state == old) return;
+
+	/* Leaving autosleep: restore the activity/inactivity settings */
+	if (old == ADXL_STATE_AUTOSLEEP) updateADXL(ADXL_REG_ACT_INACT_CTL, 0xFF, savedActInactCtl);
+
+	/* Entering autosleep: loop mode with referenced activity and inactivity detection */
+	if (state == ADXL_STATE_AUTOSLEEP)
+	{
+		savedActInactCtl = getShadowADXL(ADXL_REG_ACT_INACT_CTL);
+		updateADXL(ADXL_REG_ACT_INACT_CTL, 0b00111111, 0b00111111);
+	}
+
+	/* POWER_CTL: WAKEUP (bit 3) - AUTOSLEEP (bit 2) - MEASURE (bits 1:0) */
+	if (state == ADXL_STATE_STANDBY) updateADXL(ADXL_REG_POWER_CTL, 0b00001111, 0b00000000);
+	else if (state == ADXL_STATE_MEASURE) updateADXL(ADXL_REG_POWER_CTL, 0b00001111, 0b00000010);
+	else if (state == ADXL_STATE_WAKEUP) updateADXL(ADXL_REG_POWER_CTL, 0b00001111, 0b00001010);
+	else if (state == ADXL_STATE_AUTOSLEEP) updateADXL(ADXL_REG_POWER_CTL, 0b00001111, 0b00000110);
+
+#ifdef DEBUGGING /* DEBUGGING */
+	if (state == ADXL_STATE_STANDBY) dbinfo("Power state: standby");
+	else if (state == ADXL_STATE_MEASURE) dbinfo("Power state: measurement");
+	else if (state == ADXL_STATE_WAKEUP) dbinfo("Power state: wake-up mode");
+	else if (state == ADXL_STATE_AUTOSLEEP) dbinfo("Power state: autosleep (loop mode)");
+#endif /* DEBUGGING */
+
+	/* Let the rest of the code know */
+	if (powerHook != NULL) powerHook(state);
+}
+
+
+/**************************************************************************//**
+ * @brief
+ *   Get the current power state of the accelerometer.
+ *
+ * @details
+ *   The state is decoded from the POWER_CTL shadow, so it's also correct
+ *   after measureADXL, configADXL_boot, a soft reset or a power cycle.
+ *
+ * @return
+ *   The current power state.
+ *****************************************************************************/
+ADXL_PowerState_TypeDef getPowerStateADXL (void)
+{
+	uint8_t reg = getShadowADXL(ADXL_REG_POWER_CTL);
+
+	if ((reg & 0b00000011) == 0b00000000) return (ADXL_STATE_STANDBY);
+	else if (reg & 0b00000100) return (ADXL_STATE_AUTOSLEEP);
+	else if (reg & 0b00001000) return (ADXL_STATE_WAKEUP);
+	else return (ADXL_STATE_MEASURE);
+}
+
+
+/**************************************************************************//**
+ * @brief
+ *   Set a method that gets called after every power state transition.
+ *
+ * @param[in] hook
+ *   The method to call (NULL to disable).
+ *****************************************************************************/
+void setPowerHookADXL (void (*hook)(ADXL_PowerState_TypeDef state))
+{
+	powerHook = hook;
+}
+
+
+/**************************************************************************//**
+ * @brief
+ *   Check if the accelerometer is awake.
+ *
+ * @details
+ *   In autosleep the accelerometer switches between measurement mode
+ *   (awake) and wake-up mode (asleep) itself, the AWAKE bit in the
+ *   status register indicates which one is active.
+ *
+ * @return
+ *   @li true - Awake (or not in autosleep).
+ *   @li false - Asleep.
+ *****************************************************************************/
+bool awakeADXL (void)
+{
+	return (readADXL(ADXL_REG_STATUS) & 0b01000000);
+}
+
+
+/**************************************************************************//**
+ * @brief
+ *   Change some bits of a shadowed register without reading it first.
+ *
+ * @details
+ *   The new value is calculated using the shadow and only written if
+ *   it differs from the value the accelerometer already has.
+ *
+ * @param[in] address
+ *   The register address (ADXL_SHADOW_FIRST - ADXL_SHADOW_LAST).
+ *
+ * @param[in] mask
+ *   The bits to change.
+ *
+ * @param[in] bits
+ *   The new values for the bits selected by the mask.
+ *
+ * @param[in] caller
+ *   Only with ADXL_TRACE: the name of the calling method, so configuration
+ *   through the shadow is counted per configuration method.
+ *****************************************************************************/
+#ifdef ADXL_TRACE /* ADXL_TRACE */
+void updateADXL_traced (uint8_t address, uint8_t mask, uint8_t bits, const char *caller)
+#else
+void updateADXL (uint8_t address, uint8_t mask, uint8_t bits)
+#endif /* ADXL_TRACE */
+{
+	uint8_t old = getShadowADXL(address);
+	uint8_t reg = (old & ~mask) | (bits & mask);
+
+	if (reg != old) transferADXL(ADXL_CMD_WRITE_REG, address, &reg, 1, ADXL_CALLER);
+}
+
+
+/**************************************************************************//**
+ * @brief
+ *   Get the shadowed value of a register.
+ *
+ * @param[in] address
+ *   The register address (ADXL_SHADOW_FIRST - ADXL_SHADOW_LAST).
+ *
+ * @return
+ *   The value the register should have (0 for an unshadowed address).
+ *****************************************************************************/
+uint8_t getShadowADXL (uint8_t address)
+{
+	if ((address < ADXL_SHADOW_FIRST) || (address > ADXL_SHADOW_LAST)) return (0);
+
+	return (activeDevice->shadow[address - ADXL_SHADOW_FIRST]);
+}
+
+
+/**************************************************************************//**
+ * @brief
+ *   Read all of the shadowed registers back into the shadow.
+ *
+ * @details
+ *   Only necessary if the registers could have changed without the
+ *   MCU knowing it (SOFT_RESET always reads 0x00 so it's skipped).
+ *****************************************************************************/
+void resyncADXL (void)
+{
+	/* Burst read (address auto-increments) */
+	burstReadADXL(ADXL_SHADOW_FIRST + 1, &activeDevice->shadow[1], ADXL_SHADOW_SIZE - 1);
+
+	/* Keep the range variables in line with the shadow */
+	range = (activeDevice->shadow[ADXL_REG_FILTER_CTL - ADXL_SHADOW_FIRST] >> 6);
+	if (range > 2) range = 2; /* 1x = +- 8g */
+	activeDevice->range = range;
+
+#ifdef DEBUGGING /* DEBUGGING */
+	dbinfo("Register shadow resynchronized");
+#endif /* DEBUGGING */
+
+}
+
+
+/**************************************************************************//**
+ * @brief
+ *   Check if the registers of the accelerometer match the shadow.
+ *
+ * @return
+ *   @li true - All shadowed registers have the expected value.
+ *   @li false - At least one register differs from the shadow.
+ *****************************************************************************/
+bool verifyADXL (void)
+{
+	uint8_t buffer[ADXL_SHADOW_SIZE - 1];
+
+	/* Burst read (address auto-increments) */
+	burstReadADXL(ADXL_SHADOW_FIRST + 1, buffer, ADXL_SHADOW_SIZE - 1);
+
+	for (uint8_t i = 0; i < (ADXL_SHADOW_SIZE - 1); i++)
+	{
+		if (buffer[i] != activeDevice->shadow[i + 1])
+		{
 
 #ifdef DEBUGGING /* DEBUGGING */
-		dbinfo("Measurement enabled");
+			dbwarnInt_hex("Register 0x", (ADXL_SHADOW_FIRST + 1 + i), " differs from the shadow");
+#endif /* DEBUGGING */
+
+			return (false);
+		}
+	}
+
+	return (true);
+}
+
+
+/**************************************************************************//**
+ * @brief
+ *   Check the health of the accelerometer and repair corrupted registers.
+ *
+ * @details
+ *   DEVID_AD up to STATUS are read in one burst to check the ID and the
+ *   ERR_USER_REGS bit, after which the configuration registers are read
+ *   back and compared with the shadow. Only the registers that differ are
+ *   rewritten (neighbouring ones in one burst), which takes a few SPI
+ *   transactions instead of a full reset. The repair is verified with a
+ *   second readback. A set ERR_USER_REGS bit is a repair trigger too: it
+ *   only clears on a write, so if all registers match, SELF_TEST is
+ *   rewritten with its shadow value. Meant to be called periodically from the main loop
+ *   (see healthDueADXL).
+ *
+ * @return
+ *   @li ADXL_HEALTH_OK - Everything is fine.
+ *   @li ADXL_HEALTH_REPAIRED - Corrupted registers were rewritten.
+ *   @li ADXL_HEALTH_FAILED - Wrong ID or the registers couldn't be repaired.
+ *****************************************************************************/
+uint8_t checkHealthADXL (void)
+{
+	uint8_t id[ADXL_REG_STATUS + 1];
+	uint8_t buffer[ADXL_SHADOW_SIZE - 1];
+	uint8_t wrong = 0;
+	bool errUserRegs;
+
+	health.checks++;
+
+	/* Burst read (address auto-increments) */
+	burstReadADXL(ADXL_REG_DEVID_AD, id, ADXL_REG_STATUS + 1);
+
+	if (id[ADXL_REG_DEVID_AD] != 0xAD)
+	{
+		health.idErrors++;
+		health.failures++;
+
+#ifdef DEBUGGING /* DEBUGGING */
+		dbcritInt_hex("Health check: wrong ID (0x", id[ADXL_REG_DEVID_AD], ")");
+#endif /* DEBUGGING */
+
+		return (ADXL_HEALTH_FAILED);
+	}
+
+	/* STATUS: ERR_USER_REGS (bit 7) indicates an upset in the configuration registers */
+	errUserRegs = ((id[ADXL_REG_STATUS] & 0b10000000) != 0);
+	if (errUserRegs)
+	{
+		health.errUserRegs++;
+
+#ifdef DEBUGGING /* DEBUGGING */
+		dbwarn("Health check: ERR_USER_REGS set");
+#endif /* DEBUGGING */
+
+	}
+
+	/* Burst read (SOFT_RESET always reads 0x00, so it's skipped) */
+	burstReadADXL(ADXL_SHADOW_FIRST + 1, buffer, ADXL_SHADOW_SIZE - 1);
+
+	uint8_t i = 0;
+	while (i < (ADXL_SHADOW_SIZE - 1))
+	{
+		if (buffer[i] == activeDevice->shadow[i + 1])
+		{
+			i++;
+			continue;
+		}
+
+		/* Rewrite the run of wrong registers in one burst (the shadow is the source) */
+		uint8_t first = i;
+		while ((i < (ADXL_SHADOW_SIZE - 1)) && (buffer[i] != activeDevice->shadow[i + 1])) i++;
+
+		burstWriteADXL(ADXL_SHADOW_FIRST + 1 + first, &activeDevice->shadow[first + 1], i - first);
+		wrong += i - first;
+
+#ifdef DEBUGGING /* DEBUGGING */
+		dbwarnInt_hex("Health check: repaired register(s) from 0x", (ADXL_SHADOW_FIRST + 1 + first), "");
+#endif /* DEBUGGING */
+
+	}
+
+	/* ERR_USER_REGS only clears on a register write: the readback matches, so a harmless
+	 * rewrite of SELF_TEST (with its shadow value) clears it and it isn't counted again */
+	if ((wrong == 0) && errUserRegs)
+	{
+		writeADXL(ADXL_REG_SELF_TEST, activeDevice->shadow[ADXL_REG_SELF_TEST - ADXL_SHADOW_FIRST]);
+		health.repaired++;
+
+		return (ADXL_HEALTH_REPAIRED);
+	}
+
+	if (wrong == 0) return (ADXL_HEALTH_OK);
+
+	health.mismatches++;
+	health.repaired += wrong;
+
+	if (verifyADXL()) return (ADXL_HEALTH_REPAIRED);
+
+	health.failures++;
+
+	return (ADXL_HEALTH_FAILED);
+}
+
+
+/**************************************************************************//**
+ * @brief
+ *   Check if the next background health check is due.
+ *
+ * @details
+ *   A check costs a few bursts, running it on every wake of the main loop
+ *   (every FIFO watermark or sync tick) is a waste of energy. This returns
+ *   true once every ADXL_HEALTH_INTERVAL seconds (RTC ticks, so the time
+ *   spent in EM2 counts) and starts the next interval.
+ *
+ * @note
+ *   The RTC counter wraps around at COMP0, the interval can get longer
+ *   than ADXL_HEALTH_INTERVAL if the main loop sleeps longer than one RTC
+ *   period.
+ *
+ * @return
+ *   @li true - checkHealthADXL should be called.
+ *   @li false - The last check is less than ADXL_HEALTH_INTERVAL seconds ago.
+ *****************************************************************************/
+bool healthDueADXL (void)
+{
+	if (healthStarted && (ticksSinceADXL(healthLast) < ((uint32_t)ADXL_HEALTH_INTERVAL * ADXL_SYNC_CLOCK))) return (false);
+
+	healthStarted = true;
+	healthLast = RTC_CounterGet();
+
+	return (true);
+}
+
+
+/**************************************************************************//**
+ * @brief
+ *   Get the health counters.
+ *
+ * @param[out] counters
+ *   The location to copy the counters to.
+ *****************************************************************************/
+void getHealthADXL (ADXL_Health_TypeDef *counters)
+{
+	*counters = health;
+}
+
+
+/**************************************************************************//**
+ * @brief
+ *   Switch the range and rescale the activity and inactivity thresholds.
+ *
+ * @details
+ *   The thresholds are in "codes", so they are halved or doubled in the
+ *   same step to keep them at the same mg value. The write that raises
+ *   the effective threshold goes first, so no false activity gets
+ *   detected in between. The amount of sets in the FIFO is read right
+ *   after the FILTER_CTL write and saved so readADXL_FIFO can tag them
+ *   with the previous range (sets measured between an earlier read and
+ *   the write would otherwise get the new range).
+ *
+ * @param[in] newRange
+ *   The range to switch to (one step away from the current range).
+ *
+ * @return
+ *   @li true - The range is switched.
+ *   @li false - The thresholds don't fit in 11 bits in the new range or
+ *       sets of an earlier switch are still in the FIFO.
+ *****************************************************************************/
+static bool switchRangeADXL (uint8_t newRange)
+{
+	uint16_t act = ((getShadowADXL(ADXL_REG_THRESH_ACT_H) & 0b111) << 8) | getShadowADXL(ADXL_REG_THRESH_ACT_L);
+	uint16_t inact = ((getShadowADXL(ADXL_REG_THRESH_INACT_H) & 0b111) << 8) | getShadowADXL(ADXL_REG_THRESH_INACT_L);
+
+	if ((newRange > 2) || (newRange == range) || (oldRangeSets != 0)) return (false);
+
+	if (newRange > range)
+	{
+		act >>= 1;
+		inact >>= 1;
+	}
+	else
+	{
+		act <<= 1;
+		inact <<= 1;
+		if ((act > 0x7FF) || (inact > 0x7FF)) return (false);
+	}
+
+	uint8_t thresh[2][2] = {
+		{ act & 0xFF, act >> 8 },
+		{ inact & 0xFF, inact >> 8 }
+	};
+
+	oldRange = range;
+
+	/* Larger range: the thresholds are temporarily too high until they are halved */
+	if (newRange > oldRange)
+	{
+		updateADXL(ADXL_REG_FILTER_CTL, 0b11000000, (newRange << 6));
+		oldRangeSets = readADXL_FIFOentries() / 3;
+	}
+
+	burstWriteADXL(ADXL_REG_THRESH_ACT_L, thresh[0], 2);
+	burstWriteADXL(ADXL_REG_THRESH_INACT_L, thresh[1], 2);
+
+	/* Smaller range: the thresholds are doubled first */
+	if (newRange < oldRange)
+	{
+		updateADXL(ADXL_REG_FILTER_CTL, 0b11000000, (newRange << 6));
+		oldRangeSets = readADXL_FIFOentries() / 3;
+	}
+
+#ifdef DEBUGGING /* DEBUGGING */
+	dbinfoInt("Automatic range switch: +- ", (2 << range), "g");
+#endif /* DEBUGGING */
+
+	return (true);
+}
+
+
+/**************************************************************************//**
+ * @brief
+ *   Change the ODR for the adaptive ODR controller and log the transition.
+ *
+ * @param[in] odr
+ *   The new ODR setting.
+ *
+ * @param[in] reason
+ *   ADXL_ODR_REASON_ENERGY, ADXL_ODR_REASON_ACTIVITY or ADXL_ODR_REASON_QUIET.
+ *****************************************************************************/
+static void switchODR_ADXL (uint8_t odr, uint8_t reason)
+{
+	uint8_t old = getShadowADXL(ADXL_REG_FILTER_CTL) & 0b00000111;
+
+	if (odr == old) return;
+
+	configADXL_ODR(odr);
+
+	/* Overwrite the oldest entry if the log is full */
+	odrLog[odrLogNext].timestamp = RTC_CounterGet();
+	odrLog[odrLogNext].from = old;
+	odrLog[odrLogNext].to = odr;
+	odrLog[odrLogNext].reason = reason;
+	odrLogNext = (odrLogNext + 1) % ADXL_ODR_LOG_SIZE;
+	if (odrLogCount < ADXL_ODR_LOG_SIZE) odrLogCount++;
+
+#ifdef DEBUGGING /* DEBUGGING */
+	if (reason == ADXL_ODR_REASON_ENERGY) dbinfoInt("Adaptive ODR: ", odr, " (signal energy)");
+	else if (reason == ADXL_ODR_REASON_ACTIVITY) dbinfoInt("Adaptive ODR: ", odr, " (activity)");
+	else dbinfoInt("Adaptive ODR: ", odr, " (quiet)");
 #endif /* DEBUGGING */
 
+}
+
+
+/**************************************************************************//**
+ * @brief
+ *   Interpolate the offsets for a temperature in the correction table.
+ *
+ * @details
+ *   The temperature has a resolution of 0.065 degrees C and the last bit
+ *   toggles all the time, so the offsets are only recalculated when the
+ *   temperature moved ADXL_TEMP_HYSTERESIS or more away from the one they
+ *   belong to.
+ *
+ * @param[in] temp
+ *   The raw temperature value [LSB].
+ *****************************************************************************/
+static void updateTempOffsetADXL (int16_t temp)
+{
+	const ADXL_TempPoint_TypeDef *low = &tempTable[0];
+	const ADXL_TempPoint_TypeDef *high = &tempTable[tempPoints - 1];
+	int32_t drift = (int32_t)temp - tempCached;
+
+	if ((tempCached != INT16_MIN) && (drift < ADXL_TEMP_HYSTERESIS) && (drift > -ADXL_TEMP_HYSTERESIS)) return;
+
+	tempCached = temp;
+
+	/* Outside of the table: offsets of the closest point */
+	if (temp <= low->temp) high = low;
+	else if (temp >= high->temp) low = high;
+	else
+	{
+		/* Segment containing the temperature */
+		uint8_t i = 1;
+		while (tempTable[i].temp < temp) i++;
+		low = &tempTable[i - 1];
+		high = &tempTable[i];
+	}
+
+	for (uint8_t axis = 0; axis < 3; axis++)
+	{
+		if (low == high) tempOffset[axis] = low->offset[axis];
+		else tempOffset[axis] = low->offset[axis] + ((int32_t)(high->offset[axis] - low->offset[axis]) *
+			(temp - low->temp)) / (high->temp - low->temp);
+	}
+}
+
+
+/**************************************************************************//**
+ * @brief
+ *   Combine a scale factor with the calibration.
+ *
+ * @details
+ *   mg = (raw * scale - offset) * gain = (raw * mul + add) >> ADXL_CONV_Q,
+ *   the rounding constant is included in add.
+ *
+ * @param[in] lsb
+ *   The scale factor [mg/LSB] (ADXL_CONV_Q fractional bits).
+ *
+ * @param[out] mul
+ *   The X-Y-Z multipliers.
+ *
+ * @param[out] add
+ *   The X-Y-Z addends.
+ *****************************************************************************/
+static void calFactorsADXL (int32_t lsb, int32_t *mul, int32_t *add)
+{
+	for (uint8_t axis = 0; axis < 3; axis++)
+	{
+		mul[axis] = (int32_t)(((int64_t)lsb * calADXL.gain[axis]) >> ADXL_CONV_Q);
+		add[axis] = (1 << (ADXL_CONV_Q - 1)) - (calADXL.offset[axis] * calADXL.gain[axis]);
+	}
+}
+
+
+/**************************************************************************//**
+ * @brief
+ *   Calculate the CRC16-CCITT (polynomial 0x1021, start value 0xFFFF).
+ *
+ * @param[in] data
+ *   The data.
+ *
+ * @param[in] length
+ *   The amount of bytes.
+ *
+ * @return
+ *   The CRC.
+ *****************************************************************************/
+static uint16_t crc16ADXL (const uint8_t *data, uint16_t length)
+{
+	uint16_t crc = 0xFFFF;
+
+	for (uint16_t i = 0; i < length; i++)
+	{
+		crc ^= (uint16_t)data[i] << 8;
+
+		for (uint8_t bit = 0; bit < 8; bit++)
+		{
+			if (crc & 0x8000) crc = (crc << 1) ^ 0x1021;
+			else crc <<= 1;
+		}
+	}
+
+	return (crc);
+}
+
+
+/**************************************************************************//**
+ * @brief
+ *   Start a recovery attempt: soft reset or power cycle.
+ *
+ * @details
+ *   The SPI pins are disabled while VCC is off so the accelerometer
+ *   doesn't get powered through them.
+ *****************************************************************************/
+static void startAttemptADXL (void)
+{
+	if (recoveryAttempt >= ADXL_RECOVERY_SOFT)
+	{
+		enableSPIpinsADXL(false);
+		powerADXL(false);
+
+		scheduleWakeupADXL(ADXL_MS_TO_TICKS(ADXL_POWEROFF_WAIT));
+		recoveryState = ADXL_RECOVERY_POWER_OFF;
+	}
+	else
+	{
+		softResetADXL();
+
+		scheduleWakeupADXL(ADXL_MS_TO_TICKS(ADXL_RESET_WAIT));
+		recoveryState = ADXL_RECOVERY_RESET;
+	}
+}
+
+
+/**************************************************************************//**
+ * @brief
+ *   Fire RTC compare channel 1 after a given time.
+ *
+ * @details
+ *   Used to time the recovery steps and by sleepADXL_ticks.
+ *
+ * @param[in] ticks
+ *   The amount of RTC ticks (at least 2).
+ *****************************************************************************/
+static void scheduleWakeupADXL (uint32_t ticks)
+{
+	if (ticks < 2) ticks = 2;
+
+	/* The counter wraps around at COMP0 */
+	uint32_t top = RTC_CompareGet(0);
+	uint32_t next = RTC_CounterGet() + ticks;
+	if (next > top) next -= (top + 1);
+
+	RTC_CompareSet(1, next);
+	RTC_IntClear(RTC_IFC_COMP1);
+	RTC_IntEnable(RTC_IEN_COMP1);
+}
+
+
+#ifdef ADXL_TRACE /* ADXL_TRACE */
+/**************************************************************************//**
+ * @brief
+ *   Add a transaction to the trace and the counters of its caller.
+ *
+ * @note
+ *   Called from queueADXL with interrupts disabled.
+ *
+ * @param[in] transaction
+ *   The queued transaction.
+ *
+ * @param[in] caller
+ *   Name of the method that called the transport (the same method always
+ *   has the same pointer, so it's compared as a pointer).
+ *****************************************************************************/
+static void traceADXL (const ADXL_Transaction_TypeDef *transaction, const char *caller)
+{
+	ADXL_Trace_TypeDef *entry = &trace[traceNext];
+
+	/* Overwrite the oldest entry if the buffer is full */
+	entry->timestamp = RTC_CounterGet();
+	entry->caller = caller;
+	entry->command = transaction->command;
+	entry->address = transaction->address;
+	entry->length = transaction->length;
+
+	traceNext = (traceNext + 1) % ADXL_TRACE_SIZE;
+	traceCount++;
+
+	/* Find the caller or the first free slot */
+	for (uint8_t i = 0; i < ADXL_TRACE_CALLERS; i++)
+	{
+		if (traceCallers[i].caller == NULL)
+		{
+			traceCallers[i].caller = caller;
+			traceCallers[i].transactions = 0;
+			traceCallers[i].bytes = 0;
+		}
+
+		if (traceCallers[i].caller == caller)
+		{
+			traceCallers[i].transactions++;
+			traceCallers[i].bytes += transaction->length;
+			return;
+		}
+	}
+
+	traceOther++;
+}
+#endif /* ADXL_TRACE */
+
+
+/**************************************************************************//**
+ * @brief
+ *   Decode raw FIFO entries in place to sample sets.
+ *
+ * @details
+ *   Every 16-bit entry is replaced by its sign-extended value at the
+ *   position indicated by its axis tag (bits 15:14). A decoded set (with
+ *   its range tag) is larger than its three raw entries, so the sets are
+ *   decoded from the last one to the first one. The range tags of the
+ *   automatic range switching and the temperature compensation are only
+ *   used for the selected device.
+ *
+ * @param[in,out] samples
+ *   The raw entries (at the start of the buffer), replaced by the sets.
+ *
+ * @param[in] sets
+ *   The amount of raw sets (three entries per set).
+ *
+ * @param[in] device
+ *   The accelerometer the entries were read from.
+ *
+ * @return
+ *   The amount of decoded sample sets.
+ *****************************************************************************/
+static uint16_t decodeFifoADXL (ADXL_FifoSample_TypeDef *samples, uint16_t sets, const ADXL_Device_TypeDef *device)
+{
+	uint16_t *entry = (uint16_t *)samples;
+	uint16_t first = 0;
+
+	/* Skip entries until an X value is found (should only happen if the FIFO was misaligned) */
+	while ((first < (sets * 3)) && ((entry[first] >> 14) != 0)) first++;
+
+	if (first > 0)
+	{
+		sets = ((sets * 3) - first) / 3;
+		for (uint16_t i = 0; i < (sets * 3); i++) entry[i] = entry[i + first];
+	}
+
+	/* Decode entries in place, starting with the last set */
+	for (uint16_t i = sets; i > 0; i--)
+	{
+		int16_t value[3] = { 0, 0, 0 };
+
+		for (uint8_t j = 0; j < 3; j++)
+		{
+			uint16_t raw = entry[(i - 1) * 3 + j];
+			uint8_t axis = raw >> 14;
+
+			/* Bits 13:12 are sign extension of the 12-bit value (axis 3 is temperature) */
+			if (axis < 3) value[axis] = ((int16_t)(raw << 2)) >> 2;
+		}
+
+		if (device == activeDevice)
+		{
+			uint8_t r = ((i - 1) < oldRangeSets) ? oldRange : range;
+
+			/* Temperature compensation (offsets are zero if it's disabled) */
+			samples[i - 1].x = value[0] - (tempOffset[0] >> r);
+			samples[i - 1].y = value[1] - (tempOffset[1] >> r);
+			samples[i - 1].z = value[2] - (tempOffset[2] >> r);
+			samples[i - 1].range = r;
+		}
+		else
+		{
+			samples[i - 1].x = value[0];
+			samples[i - 1].y = value[1];
+			samples[i - 1].z = value[2];
+			samples[i - 1].range = device->range;
+		}
 	}
-	else
+
+	if (device == activeDevice) oldRangeSets = (sets < oldRangeSets) ? (oldRangeSets - sets) : 0;
+
+	return (sets);
+}
+
+
+/**************************************************************************//**
+ * @brief
+ *   Callback of the FIFO_ENTRIES read of drainADXL_devices.
+ *
+ * @details
+ *   Queues the FIFO read of the same device right away, so the bus
+ *   doesn't go idle in between the devices.
+ *
+ * @note
+ *   This method is called from the DMA interrupt handler.
+ *
+ * @param[in] transaction
+ *   The finished FIFO_ENTRIES read.
+ *****************************************************************************/
+static void drainEntriesDoneADXL (ADXL_Transaction_TypeDef *transaction)
+{
+	uint8_t i = transaction - drainCount;
+	ADXL_Device_TypeDef *device = transaction->device;
+
+	uint16_t sets = ((((drainEntries[i][1] & 0b00000011) << 8) | drainEntries[i][0])) / 3;
+	if (sets > device->maxSets) sets = device->maxSets;
+	device->sets = sets;
+
+	if (sets == 0) return;
+
+	drainFifo[i].command = ADXL_CMD_READ_FIFO;
+	drainFifo[i].address = 0x00;
+	drainFifo[i].buffer = (uint8_t *)device->samples;
+	drainFifo[i].length = sets * 3 * 2;
+	drainFifo[i].callback = NULL;
+	drainFifo[i].user = NULL;
+	drainFifo[i].device = device;
+
+	/* If the queue is full drainADXL_devices queues it */
+	drainQueued[i] = queueADXL(&drainFifo[i]);
+}
+
+
+/**************************************************************************//**
+ * @brief
+ *   Callback of the DATA_READY read.
+ *
+ * @details
+ *   A read without the DATA_READY bit in STATUS is a duplicate. The
+ *   time since the previous new sample (RTC) should be one sample period
+ *   (the ODR in the shadow, the accelerometer clock is accurate to about
+ *   10%), a gap of more than 1.5 periods means samples were missed.
+ *   The gap is only checked if both samples were taken in measurement
+ *   mode: in wake-up mode (and in autosleep, which can switch to it
+ *   without telling the MCU) the accelerometer takes about six samples
+ *   per second, whatever the ODR is.
+ *
+ * @note
+ *   This method is called from the DMA interrupt handler.
+ *
+ * @param[in] transaction
+ *   The finished read.
+ *****************************************************************************/
+static void dataReadyDoneADXL (ADXL_Transaction_TypeDef *transaction)
+{
+	(void) transaction;
+
+	if (!(drdyBuffer[0] & 0b00000001))
 	{
-		/* Get value in register */
-		uint8_t reg = readADXL(ADXL_REG_POWER_CTL);
+		drdyStats.duplicates++;
+		return;
+	}
 
-		/* AND with mask to keep the bits we don't want to change */
-		reg = reg & 0b11111100;
+	/* Period of 12.5 Hz in RTC ticks, halved for every next ODR setting */
+	uint32_t period = ((ADXL_SYNC_CLOCK * 2) / 25) >> (activeDevice->shadow[ADXL_REG_FILTER_CTL - ADXL_SHADOW_FIRST] & 0b00000111);
 
-		/* OR with new setting bits */
+	bool measuring = (getPowerStateADXL() == ADXL_STATE_MEASURE);
 
-		/* Enable measurements */
-		writeADXL(ADXL_REG_POWER_CTL, reg | 0b00000000); /* Last 2 bits are measurement mode */
+	if (measuring && drdyMeasuring)
+	{
+		/* The counter wraps around at COMP0 */
+		uint32_t delta = (drdyEdge >= drdyLast) ? (drdyEdge - drdyLast) : (drdyEdge + RTC_CompareGet(0) + 1 - drdyLast);
 
-#ifdef DEBUGGING /* DEBUGGING */
-		dbinfo("Measurement disabled (standby)");
-#endif /* DEBUGGING */
+		if (delta > (period + (period >> 1))) drdyStats.missed += ((delta + (period >> 1)) / period) - 1;
+	}
+
+	drdyLast = drdyEdge;
+	drdyMeasuring = measuring;
+	drdyStats.samples++;
+
+	if (drdyCount == ADXL_DRDY_BUFFER)
+	{
+		/* Drop the oldest sample */
+		drdyHead = (drdyHead + 1) % ADXL_DRDY_BUFFER;
+		drdyCount--;
+		drdyStats.overflows++;
+	}
+
+	ADXL_Sample_TypeDef *sample = &drdySamples[(drdyHead + drdyCount) % ADXL_DRDY_BUFFER];
+
+	sample->x    = (int16_t)((drdyBuffer[4] << 8) | drdyBuffer[3]);
+	sample->y    = (int16_t)((drdyBuffer[6] << 8) | drdyBuffer[5]);
+	sample->z    = (int16_t)((drdyBuffer[8] << 8) | drdyBuffer[7]);
+	sample->temp = (int16_t)((drdyBuffer[10] << 8) | drdyBuffer[9]);
+	sample->range = range;
+
+	/* Temperature compensation with the offsets of readADXL_dataReady (zero if it's disabled) */
+	sample->x -= tempOffset[0] >> range;
+	sample->y -= tempOffset[1] >> range;
+	sample->z -= tempOffset[2] >> range;
+
+	drdyCount++;
+}
+
+
+/**************************************************************************//**
+ * @brief
+ *   Put the shadow back at the reset values of the accelerometer.
+ *
+ * @details
+ *   Called after a soft reset and when the power is (re)enabled.
+ *
+ * @param[in] device
+ *   The accelerometer that was reset.
+ *****************************************************************************/
+static void resetShadowADXL (ADXL_Device_TypeDef *device)
+{
+	for (uint8_t i = 0; i < ADXL_SHADOW_SIZE; i++) device->shadow[i] = resetValuesADXL[i];
+
+	/* FILTER_CTL reset value selects +- 2g */
+	device->range = 0;
+
+	if (device == activeDevice)
+	{
+		range = 0;
+
+		/* The FIFO is empty after a reset */
+		oldRangeSets = 0;
 	}
 }
 
@@ -640,3 +4123,372 @@ int32_t convertGRangeToGValue (int8_t sensorValue)
 	else if (range == 2) return ((2*8*1000 / 255) * sensorValue);
 	else return (0);
 }
+
+
+/**************************************************************************//**
+ * @brief
+ *   Convert 8-bit X-Y-Z sample sets (XDATA - YDATA - ZDATA) to mg values.
+ *
+ * @details
+ *   The 8-bit registers hold bits 11:4 of the 12-bit values, so the
+ *   12-bit scale factor is multiplied by 16. The scale factor and the
+ *   calibration (gain and offset) are combined in one multiplier and one
+ *   addend per axis before the loop, the loop itself only does a multiply,
+ *   add and shift per value (no division or branching).
+ *
+ * @param[in] raw
+ *   X-Y-Z sample sets (three values per set).
+ *
+ * @param[out] mg
+ *   The converted and calibrated X-Y-Z values [mg].
+ *
+ * @param[in] sets
+ *   The amount of sample sets.
+ *****************************************************************************/
+void convertADXL_mg8 (const int8_t *raw, int16_t *mg, uint16_t sets)
+{
+	int32_t mul[3], add[3];
+
+	calFactorsADXL(mgPerLSB[range] << 4, mul, add);
+
+	for (uint16_t i = 0; i < sets; i++)
+	{
+		mg[0] = (raw[0] * mul[0] + add[0]) >> ADXL_CONV_Q;
+		mg[1] = (raw[1] * mul[1] + add[1]) >> ADXL_CONV_Q;
+		mg[2] = (raw[2] * mul[2] + add[2]) >> ADXL_CONV_Q;
+
+		raw += 3;
+		mg += 3;
+	}
+}
+
+
+/**************************************************************************//**
+ * @brief
+ *   Convert 12-bit X-Y-Z sample sets to mg values.
+ *
+ * @details
+ *   Works on X-Y-Z arrays and on the X-Y-Z part of a full resolution
+ *   sample (sets = 1). The scale factor of the current range and the
+ *   calibration are combined per axis before the loop, the loop itself
+ *   only does a multiply, add and shift per value (no division or
+ *   branching). The conversion can be done in place (raw == mg).
+ *
+ * @param[in] raw
+ *   X-Y-Z sample sets (three values per set).
+ *
+ * @param[out] mg
+ *   The converted and calibrated X-Y-Z values [mg].
+ *
+ * @param[in] sets
+ *   The amount of sample sets.
+ *****************************************************************************/
+void convertADXL_mg12 (const int16_t *raw, int16_t *mg, uint16_t sets)
+{
+	int32_t mul[3], add[3];
+
+	calFactorsADXL(mgPerLSB[range], mul, add);
+
+	for (uint16_t i = 0; i < sets; i++)
+	{
+		mg[0] = (raw[0] * mul[0] + add[0]) >> ADXL_CONV_Q;
+		mg[1] = (raw[1] * mul[1] + add[1]) >> ADXL_CONV_Q;
+		mg[2] = (raw[2] * mul[2] + add[2]) >> ADXL_CONV_Q;
+
+		raw += 3;
+		mg += 3;
+	}
+}
+
+
+/**************************************************************************//**
+ * @brief
+ *   Convert FIFO sample sets to mg values using their range tags.
+ *
+ * @details
+ *   The multipliers of all ranges are calculated before the loop, so the
+ *   result stays correct when the range changed in the middle of a batch.
+ *
+ * @param[in] samples
+ *   The sample sets (with range tags).
+ *
+ * @param[out] mg
+ *   The converted and calibrated X-Y-Z values [mg] (three values per set).
+ *
+ * @param[in] sets
+ *   The amount of sample sets.
+ *****************************************************************************/
+void convertADXL_sets (const ADXL_FifoSample_TypeDef *samples, int16_t *mg, uint16_t sets)
+{
+	int32_t mul[3][3], add[3];
+
+	for (uint8_t r = 0; r < 3; r++) calFactorsADXL(mgPerLSB[r], mul[r], add);
+
+	for (uint16_t i = 0; i < sets; i++)
+	{
+		const int32_t *m = mul[samples->range];
+
+		mg[0] = (samples->x * m[0] + add[0]) >> ADXL_CONV_Q;
+		mg[1] = (samples->y * m[1] + add[1]) >> ADXL_CONV_Q;
+		mg[2] = (samples->z * m[2] + add[2]) >> ADXL_CONV_Q;
+
+		samples++;
+		mg += 3;
+	}
+}
+
+
+/**************************************************************************//**
+ * @brief
+ *   Guided six-orientation calibration.
+ *
+ * @details
+ *   The board needs to be put with every axis pointing up and down,
+ *   the instructions are printed over UART and every step is started
+ *   with a short LED0 pulse. The result is applied and saved in the
+ *   user data page. The readings are 10 ms apart, so the calibration runs
+ *   in measurement mode at 100 Hz (the range is kept), the ODR and power
+ *   mode are restored afterwards (like selfTestADXL).
+ *****************************************************************************/
+void calibrateADXL (void)
+{
+	uint8_t saved[2], regs[2];
+
+#ifdef DEBUGGING /* DEBUGGING */
+	static const char *steps[6] = { "+X up", "+X down", "+Y up", "+Y down", "+Z up", "+Z down" };
+#endif /* DEBUGGING */
+
+	/* FILTER_CTL and POWER_CTL are written in one burst */
+	saved[0] = getShadowADXL(ADXL_REG_FILTER_CTL);
+	saved[1] = getShadowADXL(ADXL_REG_POWER_CTL);
+	regs[0] = (saved[0] & 0b11010000) | 0b00000011; /* 100 Hz, keep the range and HALF_BW */
+	regs[1] = (saved[1] & 0b00110000) | 0b00000010; /* Measurement mode, keep LOW_NOISE */
+	burstWriteADXL(ADXL_REG_FILTER_CTL, regs, 2);
+
+	for (uint8_t i = 0; i < 6; i++)
+	{
+
+#ifdef DEBUGGING /* DEBUGGING */
+		dbwarnInt("Calibration step ", i + 1, ", place the board with:");
+		dbprintln((char *)steps[i]);
+#endif /* DEBUGGING */
+
+		led0(true);
+		Delay(100);
+		led0(false);
+
+		Delay(ADXL_CAL_WAIT);
+		calibrateADXL_orientation(i);
+	}
+
+	/* Restore the ODR and power mode */
+	burstWriteADXL(ADXL_REG_FILTER_CTL, saved, 2);
+
+	calibrateADXL_finish();
+}
+
+
+/**************************************************************************//**
+ * @brief
+ *   Measure one of the six calibration orientations.
+ *
+ * @details
+ *   ADXL_CAL_SAMPLES readings of the axis pointing up or down are
+ *   averaged (10 ms apart), without the current calibration. Needs
+ *   measurement mode at 100 Hz or more (set by calibrateADXL).
+ *
+ * @param[in] orientation
+ *   ADXL_CAL_X_UP, ADXL_CAL_X_DOWN, ..., ADXL_CAL_Z_DOWN.
+ *****************************************************************************/
+void calibrateADXL_orientation (uint8_t orientation)
+{
+	ADXL_Sample_TypeDef sample;
+	int32_t sum = 0;
+
+	if (orientation > ADXL_CAL_Z_DOWN) return;
+
+	for (uint8_t i = 0; i < ADXL_CAL_SAMPLES; i++)
+	{
+		readADXL_XYZTDATA(&sample);
+
+		if (orientation < ADXL_CAL_Y_UP) sum += sample.x;
+		else if (orientation < ADXL_CAL_Z_UP) sum += sample.y;
+		else sum += sample.z;
+
+		Delay(10);
+	}
+
+	/* Average in codes to mg */
+	calMeasured[orientation] = ((sum * mgPerLSB[range]) / ADXL_CAL_SAMPLES) >> ADXL_CONV_Q;
+
+#ifdef DEBUGGING /* DEBUGGING */
+	dbinfoInt("Calibration: ", calMeasured[orientation], " mg");
+#endif /* DEBUGGING */
+
+}
+
+
+/**************************************************************************//**
+ * @brief
+ *   Calculate the calibration out of the six orientations, apply it
+ *   and save it in the user data page.
+ *
+ * @details
+ *   Offset [mg] = (up + down) / 2 and gain = 2000 mg / (up - down).
+ *
+ * @return
+ *   @li true - Calibration applied and saved.
+ *   @li false - A gain is not within 0.8 - 1.2 (wrong orientation?), the
+ *       calibration is not changed.
+ *****************************************************************************/
+bool calibrateADXL_finish (void)
+{
+	ADXL_Calibration_TypeDef cal;
+
+	cal.magic = ADXL_CAL_MAGIC;
+	cal.reserved = 0;
+
+	for (uint8_t axis = 0; axis < 3; axis++)
+	{
+		int32_t up = calMeasured[axis * 2];
+		int32_t down = calMeasured[axis * 2 + 1];
+
+		if ((up - down) <= 0) return (false);
+
+		cal.offset[axis] = (up + down) / 2;
+		cal.gain[axis] = (2000 << ADXL_CONV_Q) / (up - down);
+
+		if ((cal.gain[axis] < ((8 << ADXL_CONV_Q) / 10)) || (cal.gain[axis] > ((12 << ADXL_CONV_Q) / 10)))
+		{
+
+#ifdef DEBUGGING /* DEBUGGING */
+			dbcritInt("Calibration gain out of range (axis ", axis, ")");
+#endif /* DEBUGGING */
+
+			return (false);
+		}
+	}
+
+	return (saveADXL_calibration(&cal));
+}
+
+
+/**************************************************************************//**
+ * @brief
+ *   Load the calibration out of the user data page.
+ *
+ * @return
+ *   @li true - Valid calibration found and applied.
+ *   @li false - No (valid) calibration stored, no correction is applied.
+ *****************************************************************************/
+bool loadADXL_calibration (void)
+{
+	const ADXL_Calibration_TypeDef *stored = (const ADXL_Calibration_TypeDef *)USERDATA_BASE;
+
+	if ((stored->magic != ADXL_CAL_MAGIC) ||
+		(stored->crc != crc16ADXL((const uint8_t *)stored, sizeof(ADXL_Calibration_TypeDef) - 2)))
+	{
+
+#ifdef DEBUGGING /* DEBUGGING */
+		dbwarn("No valid calibration stored");
+#endif /* DEBUGGING */
+
+		return (false);
+	}
+
+	calADXL = *stored;
+
+#ifdef DEBUGGING /* DEBUGGING */
+	dbinfo("Calibration loaded");
+#endif /* DEBUGGING */
+
+	return (true);
+}
+
+
+/**************************************************************************//**
+ * @brief
+ *   Apply a calibration and save it (with CRC) in the user data page.
+ *
+ * @note
+ *   The user data page is erased, it can't hold anything else.
+ *
+ * @param[in] cal
+ *   The calibration (the CRC is calculated here).
+ *
+ * @return
+ *   @li true - Calibration saved.
+ *   @li false - Erasing or writing the flash failed.
+ *****************************************************************************/
+bool saveADXL_calibration (const ADXL_Calibration_TypeDef *cal)
+{
+	MSC_Status_TypeDef status;
+
+	calADXL = *cal;
+	calADXL.crc = crc16ADXL((const uint8_t *)&calADXL, sizeof(ADXL_Calibration_TypeDef) - 2);
+
+	MSC_Init();
+	status = MSC_ErasePage((uint32_t *)USERDATA_BASE);
+	if (status == mscReturnOk) status = MSC_WriteWord((uint32_t *)USERDATA_BASE, &calADXL, sizeof(ADXL_Calibration_TypeDef));
+	MSC_Deinit();
+
+#ifdef DEBUGGING /* DEBUGGING */
+	if (status == mscReturnOk) dbinfo("Calibration saved");
+	else dbcritInt("Saving the calibration failed (", status, ")");
+#endif /* DEBUGGING */
+
+	return (status == mscReturnOk);
+}
+
+
+/**************************************************************************//**
+ * @brief
+ *   Compare the amount of cycles the conversion methods need.
+ *
+ * @details
+ *   The SysTick counter (core clock, counts down) is used since the
+ *   Cortex-M0+ has no cycle counter. The measured blocks stay well below
+ *   one SysTick period (1 ms). The results are printed over UART.
+ *****************************************************************************/
+void benchmarkConvertADXL (void)
+{
+
+#ifdef DEBUGGING /* DEBUGGING */
+
+	int8_t raw8[48];
+	int16_t raw12[48];
+	int16_t mg[48];
+	volatile int32_t sink;
+	uint32_t start, cycles;
+	uint32_t period = (SysTick->LOAD & SysTick_LOAD_RELOAD_Msk) + 1;
+
+	/* Test data (16 X-Y-Z sets) */
+	for (uint8_t i = 0; i < 48; i++)
+	{
+		raw8[i] = (int8_t)(i * 5 - 120);
+		raw12[i] = (int16_t)(i * 85 - 2040);
+	}
+
+	/* Current method, one call per value */
+	start = SysTick->VAL;
+	for (uint8_t i = 0; i < 48; i++) sink = convertGRangeToGValue(raw8[i]);
+	cycles = (start + period - SysTick->VAL) % period;
+	dbinfoInt("convertGRangeToGValue: ", cycles, " cycles for 16 sets");
+
+	/* Batch conversion, 8-bit values */
+	start = SysTick->VAL;
+	convertADXL_mg8(raw8, mg, 16);
+	cycles = (start + period - SysTick->VAL) % period;
+	dbinfoInt("convertADXL_mg8:       ", cycles, " cycles for 16 sets");
+
+	/* Batch conversion, 12-bit values */
+	start = SysTick->VAL;
+	convertADXL_mg12(raw12, mg, 16);
+	cycles = (start + period - SysTick->VAL) % period;
+	dbinfoInt("convertADXL_mg12:      ", cycles, " cycles for 16 sets");
+
+	(void) sink;
+
+#endif /* DEBUGGING */
+
+}
@@ -10,29 +10,47 @@
 
 
 /* Global variables */
-volatile bool triggered = false; /* Accelerometer triggered interrupt */
+volatile bool triggered = false;     /* Accelerometer triggered interrupt */
+volatile bool fifoWatermark = false; /* Accelerometer FIFO watermark interrupt */
+volatile bool syncDrain = false;     /* Synchronized sampling: FIFO block ready */
+volatile bool adxlRecovery = false;  /* Next step of the accelerometer recovery */
 
 
 /**************************************************************************//**
  * @brief
  *   RTCC interrupt service routine.
  *
+ * @details
+ *   Compare channel 0 wakes up the MCU periodically, the counter wraps
+ *   around on its own (COMP0 is the top value). Compare channel 1 is used
+ *   to time the steps of the accelerometer recovery or, if there's no
+ *   recovery going on, to trigger the accelerometer in synchronized
+ *   sampling mode.
+ *
  * @note
  *   The "weak" definition for this method is located in "system_efm32hg.h".
  *****************************************************************************/
 void RTC_IRQHandler (void)
 {
-	/* Reset counter */
-	RTC_CounterReset();
-
-	/* Clear the interrupt source */
-	RTC_IntClear(RTC_IFC_COMP0);
+	/* Read interrupt flags */
+	uint32_t flags = RTC_IntGet();
+
+	/* Trigger a sample first to keep the jitter low */
+	if (flags & RTC_IF_COMP1)
+	{
+		if (recoveryBusyADXL()) adxlRecovery = true;
+		else if (triggerADXL_sync()) syncDrain = true;
+		RTC_IntClear(RTC_IFC_COMP1);
+	}
+
+	/* Clear the interrupt source (no counter reset, this would shift the COMP1 triggers) */
+	if (flags & RTC_IF_COMP0) RTC_IntClear(RTC_IFC_COMP0);
 }
 
 
 /**************************************************************************//**
  * @brief
- *   GPIO Even IRQ for pushbuttons on even-numbered pins.
+ *   GPIO Even IRQ for pushbuttons and ADXL_INT2 on even-numbered pins.
  *
  * @note
  *   The "weak" definition for this method is located in "system_efm32hg.h".
@@ -42,11 +60,22 @@ void GPIO_EVEN_IRQHandler(void)
 	/* Read interrupt flags */
 	uint32_t flags = GPIO_IntGet();
 
+	/* Read a new sample right away (no debug output, it would take longer than a sample period) */
+	if ((flags & 0x40) && dataReadyADXL())
+	{
+		GPIO_IntClear(0x40);
+		return;
+	}
+
 #ifdef DEBUGGING /* DEBUGGING */
 	dbinfo("Even numbered GPIO interrupt triggered.");
 	if (flags == 0x400) dbprint_color("PB1\n\r", 4);
+	else if (flags == 0x40) dbprint_color("INT2-PD6\n\r", 4);
 #endif /* DEBUGGING */
 
+	/* Indicate that the accelerometer FIFO reached the watermark */
+	if (flags & 0x40) fifoWatermark = true;
+
 	/* Clear all even pin interrupt flags */
 	GPIO_IntClear(0x5555);
 }
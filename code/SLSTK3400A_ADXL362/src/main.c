@@ -14,7 +14,10 @@
  *     PE12: CLK
  *     PD04: NCS
  *     PD05: VCC
+ *     PD06: INT2
  *     PD07: INT1
+ *     PC01: NCS (second accelerometer, optional)
+ *     PA00: NCS (third accelerometer, optional)
  *
  *   LED's:
  *     PF04: LED0
@@ -45,6 +48,39 @@
 #include "../inc/debugging.h" /* Enable or disable printing to UART for debugging */
 
 
+/* Buffer for the FIFO sample sets */
+ADXL_FifoSample_TypeDef fifoSamples[ADXL_FIFO_SETS];
+uint16_t fifoSets = 0; /* Amount of valid sets in fifoSamples */
+uint32_t fifoTimestamp = 0; /* RTC tick of the first set (synchronized sampling) */
+
+/* Samples read on DATA_READY */
+ADXL_Sample_TypeDef readySamples[ADXL_DRDY_BUFFER];
+uint8_t readyCount = 0;
+
+/* Event record for the triggered FIFO capture (uses the same buffer) */
+ADXL_Event_TypeDef event = { fifoSamples, ADXL_FIFO_SETS, 0, 0, 0 };
+
+
+/* Zero-g offsets of this board at about -20, 25 and 70 degrees C (raw temperature values) */
+const ADXL_TempPoint_TypeDef tempTable[] = {
+	{ -342, { 0, 0, 0 } },
+	{  350, { 0, 0, 0 } },
+	{ 1042, { 0, 0, 0 } }
+};
+
+
+/* Result of the (last) self-test at startup, kept for telemetry */
+ADXL_SelfTest_TypeDef selfTest;
+uint8_t selfTestRuns = 0;
+
+/* Noise floor measured to set the activity/inactivity thresholds */
+ADXL_NoiseFloor_TypeDef noiseFloor;
+
+
+/* Power state of the accelerometer (kept up to date by powerHook) */
+volatile ADXL_PowerState_TypeDef adxlState = ADXL_STATE_STANDBY;
+
+
 /* Definitions for RTC compare interrupts */
 #define DELAY_RTC 60.0 /* seconds */
 #define LFXOFREQ 32768
@@ -57,7 +93,7 @@
  *
  * @details
  *   Initialize buttons PB0 and PB1 on falling-edge interrupts and
- *   ADXL_INT1 on rising-edge interrupts.
+ *   ADXL_INT1 and ADXL_INT2 on rising-edge interrupts.
  *****************************************************************************/
 void initGPIOwakeup (void)
 {
@@ -68,8 +104,13 @@ void initGPIOwakeup (void)
 	GPIO_PinModeSet(PB0_PORT, PB0_PIN, gpioModeInputPullFilter, 1);
 	GPIO_PinModeSet(PB1_PORT, PB1_PIN, gpioModeInputPullFilter, 1);
 
-	/* Configure ADXL_INT1 as input */
+	/* Configure ADXL_INT1 and ADXL_INT2 as input */
 	GPIO_PinModeSet(ADXL_INT1_PORT, ADXL_INT1_PIN, gpioModeInput, 1);
+	GPIO_PinModeSet(ADXL_INT2_PORT, ADXL_INT2_PIN, gpioModeInput, 1);
+
+	/* Lower priority than the DMA, the GPIO handlers queue SPI transactions (DATA_READY) */
+	NVIC_SetPriority(GPIO_EVEN_IRQn, 1);
+	NVIC_SetPriority(GPIO_ODD_IRQn, 1);
 
 	/* Enable IRQ for even numbered GPIO pins */
 	NVIC_EnableIRQ(GPIO_EVEN_IRQn);
@@ -81,8 +122,22 @@ void initGPIOwakeup (void)
 	GPIO_IntConfig(PB0_PORT, PB0_PIN, 0, 1, true);
 	GPIO_IntConfig(PB1_PORT, PB1_PIN, 0, 1, true);
 
-	/* Enable rising-edge interrupts for ADXL_INT1 */
+	/* Enable rising-edge interrupts for ADXL_INT1 and ADXL_INT2 */
 	GPIO_IntConfig(ADXL_INT1_PORT, ADXL_INT1_PIN, 1, 0, true);
+	GPIO_IntConfig(ADXL_INT2_PORT, ADXL_INT2_PIN, 1, 0, true);
+}
+
+
+/**************************************************************************//**
+ * @brief
+ *   Method called by the accelerometer code after every power state transition.
+ *
+ * @param[in] state
+ *   The new power state.
+ *****************************************************************************/
+void powerHook (ADXL_PowerState_TypeDef state)
+{
+	adxlState = state;
 }
 
 
@@ -153,35 +208,92 @@ int main (void)
 	/* Initialize LED's */
 	initLEDS();
 
+	/* Keep track of the power state of the accelerometer */
+	setPowerHookADXL(powerHook);
+
 	/* Soft reset ADXL handler */
 	resetHandlerADXL();
 
 
+	/* Apply the offset and gain calibration out of the user data page (if there is one) */
+	loadADXL_calibration();
+
+
+	/* Check for stuck axes (about 250 ms, the board shouldn't move during the test).
+	 * A failure can be false (the board moved or the test overran ADXL_ST_BUDGET),
+	 * so it's retried once, after that the accelerometer is recovered and the
+	 * firmware keeps running. The result is kept in "selfTest" */
+	selfTestRuns = 1;
+	if (!selfTestADXL(&selfTest))
+	{
+		selfTestRuns = 2;
+		if (!selfTestADXL(&selfTest))
+		{
+
+#ifdef DEBUGGING /* DEBUGGING */
+			dbwarn("Self-test failed twice, recovering the accelerometer");
+#endif /* DEBUGGING */
+
+			resetHandlerADXL();
+		}
+	}
+
+
 	/* Profile the ADXL (make sure to not use VCOM here!) */
 	//testADXL();
 
 
-	/* Set the measurement range (0 - 1 - 2) */
-	configADXL_range(1); /* 0 = +-2g -- 1 = +-4g -- 3 = +-8g */
+	/* Write range, ODR, activity detection on INT1, FIFO watermark on INT2
+	 * and measurement mode in one burst (settings are located in "accel.h") */
+	configADXL_boot();
+
+
+	/* Activity at 8x and inactivity at 4x the noise floor (the board shouldn't move for 2 seconds),
+	 * ADXL_CFG_ACT_THRESH and ADXL_CFG_INACT_THRESH are kept if this fails */
+	tuneADXL_thresholds(8, 4, 2000, &noiseFloor);
+
 
-	/* Configure ODR (0 - 1 - 2 - 3 - 4 - 5) */
-	configADXL_ODR(0); /* 0 = 12.5 Hz -- 3 = 100 Hz (reset default) */
+	/* Capture 32 sets before and 96 sets after an activity event instead of streaming */
+	//configADXL_capture(32, 96);
 
 
 	/* Read and display values forever */
 	//readValuesADXL();
 
 
-	/* Configure activity detection on INT1 */
-	configADXL_activity(3); /* [g] */
+	/* Six-orientation calibration, the result is saved in the user data page (runs at 100 Hz, the configuration is restored) */
+	//calibrateADXL();
+
+
+	/* Correct the zero-g offsets for the temperature (fill in tempTable first) */
+	//configADXL_tempComp(tempTable, 3);
+
+
+	/* Switch between +-2g, +-4g and +-8g depending on the FIFO samples */
+	//configADXL_autoRange(true);
+
 
-	/* Enable wake-up mode */
-	/* TODO: Maybe implement this in the future... */
-	//writeADXL(ADXL_REG_POWER_CTL, 0b00001000); /* 5th bit */
+	/* Adapt the ODR to the signal, meet a 10 Hz bandwidth, back to 12.5 Hz after 5 seconds of quiet */
+	//configADXL_adaptiveODR(10, 5000);
 
 
-	/* Enable measurements */
-	measureADXL(true);
+	/* Enable wake-up mode (activity detection on INT1 keeps working) */
+	setPowerStateADXL(ADXL_STATE_WAKEUP);
+
+
+	/* Let the MCU trigger every sample at 100 Hz instead (uses INT2 and RTC COMP1, needs measurement mode) */
+	//setPowerStateADXL(ADXL_STATE_MEASURE);
+	//configADXL_sync(100);
+
+	/* Read every sample exactly once on DATA_READY (INT2) instead of the FIFO watermark (MCU in EM1) */
+	//configADXL_dataReady(true);
+
+	/* Sparse sampling: cut VCC in between bursts (powerUpADXL_restore before the next burst) */
+	//powerDownADXL_gated();
+
+	/* Extra accelerometers on the same SPI bus (drained with drainADXL_devices(devices, 3)) */
+	//initADXL_device(&adxl2, ADXL2_NCS_PORT, ADXL2_NCS_PIN, samples2, 64);
+	//initADXL_device(&adxl3, ADXL3_NCS_PORT, ADXL3_NCS_PIN, samples3, 64);
 
 #ifdef DEBUGGING /* DEBUGGING */
 	dbprintln("");
@@ -189,28 +301,100 @@ int main (void)
 
 	while(1)
 	{
-		led0(true); /* Enable LED0 */
-		Delay(1000);
-		led0(false); /* Disable LED0 */
+		/* Next step of the recovery (RTC compare channel 1), the accelerometer can't be used until it's done */
+		if (adxlRecovery)
+		{
+			adxlRecovery = false;
+			recoveryStepADXL();
+		}
+
+		bool adxlReady = !recoveryBusyADXL() && !gatedADXL();
+
+		/* Not in DATA_READY or synchronized sampling mode, the busy-wait would break the sample timing */
+		if (adxlReady && !dataReadyEnabledADXL() && (getSyncPeriodADXL() == 0))
+		{
+			led0(true); /* Enable LED0 */
+			Delay(1000);
+			led0(false); /* Disable LED0 */
+		}
 
-		/* Read status register to acknowledge interrupt
-		 * (can be disabled by changing LINK/LOOP mode in ADXL_REG_ACT_INACT_CTL) */
-		if (triggered)
+		/* The accelerometer runs in loop mode (see ADXL_CFG_ACT_INACT_CTL) and re-arms itself,
+		 * acknowledgeADXL only queues a STATUS read if another link mode is configured */
+		if (adxlReady && triggered)
 		{
-			readADXL(ADXL_REG_STATUS);
+			/* Only does something if the adaptive ODR controller is enabled */
+			activityADXL_ODR();
+
+			/* Get the samples around the event if the capture is configured */
+			if (captureArmedADXL()) captureADXL_event(&event);
+
+			acknowledgeADXL();
 			triggered = false;
 		}
 
+		/* Drain the FIFO in synchronized sampling mode (INT2 is an output then) */
+		if (adxlReady && syncDrain)
+		{
+			syncDrain = false;
+			fifoSets = readADXL_sync(fifoSamples, ADXL_FIFO_SETS, &fifoTimestamp);
+
+#ifdef DEBUGGING /* DEBUGGING */
+			dbinfoInt("Read ", fifoSets, " synchronized sample sets");
+			dbinfoInt("First set at RTC tick ", fifoTimestamp, "");
+#endif /* DEBUGGING */
+
+		}
+
+		/* Samples read by the GPIO interrupt handler on DATA_READY (INT2) */
+		else if (adxlReady && dataReadyEnabledADXL())
+		{
+			/* The queue was full on the last edge, INT2 stays high until the sample is read */
+			if (GPIO_PinInGet(ADXL_INT2_PORT, ADXL_INT2_PIN)) dataReadyADXL();
+
+			readyCount = readADXL_dataReady(readySamples, ADXL_DRDY_BUFFER);
+
+#ifdef DEBUGGING /* DEBUGGING */
+			dbinfoInt("Read ", readyCount, " DATA_READY samples");
+#endif /* DEBUGGING */
+
+		}
+
+		/* Drain the FIFO (also check the pin in case an edge was missed, INT2 stays high until the FIFO is read) */
+		else if (adxlReady && (getSyncPeriodADXL() == 0) && (fifoWatermark || GPIO_PinInGet(ADXL_INT2_PORT, ADXL_INT2_PIN)))
+		{
+			fifoSets = readADXL_FIFO(fifoSamples, ADXL_FIFO_SETS);
+			fifoWatermark = false;
+
+			/* Only does something if automatic range switching is enabled */
+			autoRangeADXL(fifoSamples, fifoSets);
+			adaptADXL_ODR(fifoSamples, fifoSets);
+
+#ifdef DEBUGGING /* DEBUGGING */
+			dbinfoInt("Read ", fifoSets, " sample sets from the FIFO");
+#endif /* DEBUGGING */
+
+		}
+
 #ifdef DEBUGGING /* DEBUGGING */
 	dbinfo("Disabling systick & going to sleep...\r\n");
 #endif /* DEBUGGING */
 
-		systickInterrupts(false); /* Disable SysTick interrupts */
-		enableSPIpinsADXL(false); /* Disable SPI pins */
+		/* Rewrite corrupted registers (every ADXL_HEALTH_INTERVAL seconds), the recovery (which restores the configuration) is only started if this doesn't work */
+		if (adxlReady && healthDueADXL() && (checkHealthADXL() == ADXL_HEALTH_FAILED)) startADXL_recovery();
+
+		waitQueueADXL(); /* Finish queued SPI transactions */
 
-		EMU_EnterEM2(false); /* "true" doesn't seem to have any effect (save and restore oscillators, clocks and voltage scaling) */
+		/* The GPIO handler reads every sample on DATA_READY, USART0 and the DMA need EM1 */
+		if (dataReadyEnabledADXL()) EMU_EnterEM1();
+		else
+		{
+			systickInterrupts(false); /* Disable SysTick interrupts */
+			enableSPIpinsADXL(false); /* Disable SPI pins */
 
-		enableSPIpinsADXL(true); /* Enable SPI pins */
-		systickInterrupts(true); /* Enable SysTick interrupts */
+			EMU_EnterEM2(false); /* "true" doesn't seem to have any effect (save and restore oscillators, clocks and voltage scaling) */
+
+			if (poweredADXL()) enableSPIpinsADXL(true); /* Enable SPI pins (not while VCC is off) */
+			systickInterrupts(true); /* Enable SysTick interrupts */
+		}
 	}
 }
@@ -0,0 +1,15 @@
+/***************************************************************************//**
+ * @file em_chip.h
+ * @brief Host-side stand-in for the emlib header (used by the tests only).
+ ******************************************************************************/
+
+#ifndef STUB_EM_CHIP_H
+#define STUB_EM_CHIP_H
+#ifdef __cplusplus
+extern "C" {
+#endif
+void CHIP_Init(void);
+#ifdef __cplusplus
+}
+#endif
+#endif
@@ -0,0 +1,19 @@
+/***************************************************************************//**
+ * @file em_cmu.h
+ * @brief Host-side stand-in for the emlib header (used by the tests only).
+ ******************************************************************************/
+
+#ifndef STUB_EM_CMU_H
+#define STUB_EM_CMU_H
+#ifdef __cplusplus
+extern "C" {
+#endif
+#include "em_device.h"
+typedef enum { cmuClock_GPIO, cmuClock_USART0, cmuClock_HFLE, cmuClock_LFA, cmuClock_RTC, cmuClock_CORE, cmuClock_DMA, cmuClock_TIMER1, cmuClock_HFPER } CMU_Clock_TypeDef;
+typedef enum { cmuOsc_LFXO } CMU_Osc_TypeDef; typedef enum { cmuSelect_LFXO } CMU_Select_TypeDef;
+void CMU_ClockEnable(CMU_Clock_TypeDef, bool); uint32_t CMU_ClockFreqGet(CMU_Clock_TypeDef);
+void CMU_OscillatorEnable(CMU_Osc_TypeDef, bool, bool); void CMU_ClockSelectSet(CMU_Clock_TypeDef, CMU_Select_TypeDef);
+#ifdef __cplusplus
+}
+#endif
+#endif
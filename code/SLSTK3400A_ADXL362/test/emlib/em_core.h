@@ -0,0 +1,20 @@
+/***************************************************************************//**
+ * @file em_core.h
+ * @brief Host-side stand-in for the emlib header (used by the tests only).
+ ******************************************************************************/
+
+#ifndef STUB_EM_CORE_H
+#define STUB_EM_CORE_H
+#ifdef __cplusplus
+extern "C" {
+#endif
+#include "em_device.h"
+typedef uint32_t CORE_irqState_t;
+#define CORE_DECLARE_IRQ_STATE CORE_irqState_t irqState
+#define CORE_ENTER_ATOMIC() irqState = 0
+#define CORE_EXIT_ATOMIC() (void)irqState
+#define CORE_ATOMIC_SECTION(x) { x }
+#ifdef __cplusplus
+}
+#endif
+#endif
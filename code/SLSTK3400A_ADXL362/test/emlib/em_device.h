@@ -0,0 +1,55 @@
+/***************************************************************************//**
+ * @file em_device.h
+ * @brief Host-side stand-in for the emlib header (used by the tests only).
+ ******************************************************************************/
+
+#ifndef EM_DEVICE_H
+#define EM_DEVICE_H
+#ifdef __cplusplus
+extern "C" {
+#endif
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+void NVIC_SetPriority(int, uint32_t);
+#define __IOM volatile
+typedef struct { volatile uint32_t CTRL, FRAME, TRIGCTRL, CMD, STATUS, CLKDIV, RXDATAX, RXDATA, RXDOUBLEX, RXDOUBLE, RXDATAXP, RXDOUBLEXP, TXDATAX, TXDATA, TXDOUBLEX, TXDOUBLE, IF, IFS, IFC, IEN, IRCTRL, ROUTE; } USART_TypeDef;
+typedef struct { volatile uint32_t CTRL, CNT, COMP0, COMP1, IF, IFS, IFC, IEN, FREEZE, SYNCBUSY; } RTC_TypeDef;
+typedef struct { volatile uint32_t CTRL, LOAD, VAL, CALIB; } SysTick_Type;
+typedef struct { volatile uint32_t CTRL, CMD, STATUS, ROUTE, IF, IFS, IFC, IEN, TOP, TOPB, CNT; } TIMER_TypeDef;
+extern USART_TypeDef *USART0, *USART1; extern RTC_TypeDef *RTC; extern SysTick_Type *SysTick; extern TIMER_TypeDef *TIMER0, *TIMER1;
+#define USART_ROUTE_CLKPEN 1
+#define USART_ROUTE_CSPEN 2
+#define USART_ROUTE_TXPEN 4
+#define USART_ROUTE_RXPEN 8
+#define USART_ROUTE_LOCATION_LOC0 0
+#define USART_CMD_CLEARRX 0x800
+#define USART_CMD_CLEARTX 0x400
+#define USART_STATUS_TXC 0x20
+#define USART_STATUS_TXBL 0x40
+#define USART_STATUS_RXDATAV 0x80
+#define USART_TXDATA_TXDATA_SHIFT 0
+#define SysTick_CTRL_TICKINT_Msk 2
+#define SysTick_CTRL_ENABLE_Msk 1
+#define SysTick_LOAD_RELOAD_Msk 0xFFFFFF
+#define SysTick_VAL_CURRENT_Msk 0xFFFFFF
+#define RTC_IFC_COMP0 1
+#define RTC_IFC_COMP1 2
+#define RTC_IF_COMP0 1
+#define RTC_IF_COMP1 2
+#define RTC_IEN_COMP0 1
+#define RTC_IEN_COMP1 2
+#define RTC_CNT_CNT_MASK 0xFFFFFF
+#define DMA_CHAN_COUNT 6
+#define DMAREQ_USART0_RXDATAV 0x0C0000
+#define DMAREQ_USART0_TXBL 0x0C0001
+#define USERDATA_BASE 0x0FE00000UL
+#define FLASH_PAGE_SIZE 1024
+typedef enum { GPIO_EVEN_IRQn, GPIO_ODD_IRQn, RTC_IRQn, DMA_IRQn } IRQn_Type;
+void NVIC_EnableIRQ(IRQn_Type); void NVIC_DisableIRQ(IRQn_Type); void NVIC_ClearPendingIRQ(IRQn_Type);
+uint32_t SysTick_Config(uint32_t);
+void __disable_irq(void); void __enable_irq(void); void __WFI(void); void __NOP(void);
+#ifdef __cplusplus
+}
+#endif
+#endif
@@ -0,0 +1,27 @@
+/***************************************************************************//**
+ * @file em_dma.h
+ * @brief Host-side stand-in for the emlib header (used by the tests only).
+ ******************************************************************************/
+
+#ifndef STUB_EM_DMA_H
+#define STUB_EM_DMA_H
+#ifdef __cplusplus
+extern "C" {
+#endif
+#include "em_device.h"
+typedef void (*DMA_FuncPtr_TypeDef)(unsigned int channel, bool primary, void *user);
+typedef struct { DMA_FuncPtr_TypeDef cbFunc; void *userPtr; uint8_t primary; } DMA_CB_TypeDef;
+typedef struct { bool highPri; bool enableInt; uint32_t select; DMA_CB_TypeDef *cb; } DMA_CfgChannel_TypeDef;
+typedef enum { dmaDataInc1, dmaDataInc2, dmaDataInc4, dmaDataIncNone } DMA_DataInc_TypeDef;
+typedef enum { dmaDataSize1, dmaDataSize2, dmaDataSize4 } DMA_DataSize_TypeDef;
+typedef enum { dmaArbitrate1 } DMA_ArbiterConfig_TypeDef;
+typedef struct { DMA_DataInc_TypeDef dstInc; DMA_DataInc_TypeDef srcInc; DMA_DataSize_TypeDef size; DMA_ArbiterConfig_TypeDef arbRate; uint8_t hprot; } DMA_CfgDescr_TypeDef;
+typedef struct { volatile void *SRCEND; volatile void *DSTEND; volatile uint32_t CTRL; volatile uint32_t USER; } DMA_DESCRIPTOR_TypeDef;
+typedef struct { uint8_t hprot; DMA_DESCRIPTOR_TypeDef *controlBlock; } DMA_Init_TypeDef;
+void DMA_Init(DMA_Init_TypeDef*); void DMA_CfgChannel(unsigned int, DMA_CfgChannel_TypeDef*); void DMA_CfgDescr(unsigned int, bool, DMA_CfgDescr_TypeDef*);
+void DMA_ActivateBasic(unsigned int, bool, bool, void*, const void*, unsigned int); bool DMA_ChannelEnabled(unsigned int);
+#define _DMA_CTRL_N_MINUS_1_MASK 0x3FF0UL
+#ifdef __cplusplus
+}
+#endif
+#endif
@@ -0,0 +1,16 @@
+/***************************************************************************//**
+ * @file em_emu.h
+ * @brief Host-side stand-in for the emlib header (used by the tests only).
+ ******************************************************************************/
+
+#ifndef STUB_EM_EMU_H
+#define STUB_EM_EMU_H
+#ifdef __cplusplus
+extern "C" {
+#endif
+#include "em_device.h"
+void EMU_EnterEM1(void); void EMU_EnterEM2(bool);
+#ifdef __cplusplus
+}
+#endif
+#endif
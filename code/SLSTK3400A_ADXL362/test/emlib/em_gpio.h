@@ -0,0 +1,22 @@
+/***************************************************************************//**
+ * @file em_gpio.h
+ * @brief Host-side stand-in for the emlib header (used by the tests only).
+ ******************************************************************************/
+
+#ifndef STUB_EM_GPIO_H
+#define STUB_EM_GPIO_H
+#ifdef __cplusplus
+extern "C" {
+#endif
+#include "em_device.h"
+typedef enum { gpioPortA, gpioPortB, gpioPortC, gpioPortD, gpioPortE, gpioPortF } GPIO_Port_TypeDef;
+typedef enum { gpioModeDisabled, gpioModeInput, gpioModeInputPull, gpioModeInputPullFilter, gpioModePushPull } GPIO_Mode_TypeDef;
+void GPIO_PinModeSet(GPIO_Port_TypeDef, unsigned int, GPIO_Mode_TypeDef, unsigned int);
+void GPIO_PinOutSet(GPIO_Port_TypeDef, unsigned int); void GPIO_PinOutClear(GPIO_Port_TypeDef, unsigned int); void GPIO_PinOutToggle(GPIO_Port_TypeDef, unsigned int);
+unsigned int GPIO_PinInGet(GPIO_Port_TypeDef, unsigned int);
+uint32_t GPIO_IntGet(void); void GPIO_IntClear(uint32_t); void GPIO_IntConfig(GPIO_Port_TypeDef, unsigned int, bool, bool, bool);
+void GPIO_IntEnable(uint32_t); void GPIO_IntDisable(uint32_t);
+#ifdef __cplusplus
+}
+#endif
+#endif
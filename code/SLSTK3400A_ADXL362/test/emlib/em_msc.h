@@ -0,0 +1,17 @@
+/***************************************************************************//**
+ * @file em_msc.h
+ * @brief Host-side stand-in for the emlib header (used by the tests only).
+ ******************************************************************************/
+
+#ifndef STUB_EM_MSC_H
+#define STUB_EM_MSC_H
+#ifdef __cplusplus
+extern "C" {
+#endif
+#include "em_device.h"
+typedef enum { mscReturnOk = 0 } MSC_Status_TypeDef;
+void MSC_Init(void); void MSC_Deinit(void); MSC_Status_TypeDef MSC_ErasePage(uint32_t*); MSC_Status_TypeDef MSC_WriteWord(uint32_t*, const void*, uint32_t);
+#ifdef __cplusplus
+}
+#endif
+#endif
@@ -0,0 +1,19 @@
+/***************************************************************************//**
+ * @file em_rtc.h
+ * @brief Host-side stand-in for the emlib header (used by the tests only).
+ ******************************************************************************/
+
+#ifndef STUB_EM_RTC_H
+#define STUB_EM_RTC_H
+#ifdef __cplusplus
+extern "C" {
+#endif
+#include "em_device.h"
+typedef struct { bool enable; bool debugRun; bool comp0Top; } RTC_Init_TypeDef;
+#define RTC_INIT_DEFAULT { true, false, true }
+void RTC_CounterReset(void); void RTC_IntClear(uint32_t); void RTC_IntEnable(uint32_t); void RTC_IntDisable(uint32_t); uint32_t RTC_IntGet(void);
+void RTC_CompareSet(unsigned int, uint32_t); uint32_t RTC_CompareGet(unsigned int); uint32_t RTC_CounterGet(void); void RTC_Init(const RTC_Init_TypeDef*);
+#ifdef __cplusplus
+}
+#endif
+#endif
@@ -0,0 +1,15 @@
+/***************************************************************************//**
+ * @file em_timer.h
+ * @brief Host-side stand-in for the emlib header (used by the tests only).
+ ******************************************************************************/
+
+#ifndef STUB_EM_TIMER_H
+#define STUB_EM_TIMER_H
+#ifdef __cplusplus
+extern "C" {
+#endif
+#include "em_device.h"
+#ifdef __cplusplus
+}
+#endif
+#endif
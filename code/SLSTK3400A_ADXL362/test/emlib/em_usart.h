@@ -0,0 +1,21 @@
+/***************************************************************************//**
+ * @file em_usart.h
+ * @brief Host-side stand-in for the emlib header (used by the tests only).
+ ******************************************************************************/
+
+#ifndef STUB_EM_USART_H
+#define STUB_EM_USART_H
+#ifdef __cplusplus
+extern "C" {
+#endif
+#include "em_device.h"
+typedef enum { usartDisable, usartEnable } USART_Enable_TypeDef;
+typedef enum { usartDatabits8 } USART_Databits_TypeDef; typedef enum { usartClockMode0 } USART_ClockMode_TypeDef;
+typedef struct { USART_Enable_TypeDef enable; uint32_t refFreq; uint32_t baudrate; USART_Databits_TypeDef databits; bool master; bool msbf; USART_ClockMode_TypeDef clockMode; bool prsRxEnable; int prsRxCh; bool autoTx; bool autoCsEnable; } USART_InitSync_TypeDef;
+#define USART_INITSYNC_DEFAULT { usartEnable, 0, 1000000, usartDatabits8, true, false, usartClockMode0, false, 0, false, false }
+void USART_InitSync(USART_TypeDef*, const USART_InitSync_TypeDef*); void USART_Enable(USART_TypeDef*, USART_Enable_TypeDef);
+uint8_t USART_SpiTransfer(USART_TypeDef*, uint8_t);
+#ifdef __cplusplus
+}
+#endif
+#endif
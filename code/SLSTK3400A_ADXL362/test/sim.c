@@ -0,0 +1,376 @@
+/***************************************************************************//**
+ * @file sim.c
+ * @brief Simulated GPIO, USART0, DMA, RTC and ADXL362 for the host tests.
+ *
+ * @details
+ *   The accelerometer follows the SPI protocol of the datasheet: after CS
+ *   goes low the first byte is the command, the second one the address
+ *   (except for the read FIFO command), the next bytes are data and the
+ *   address auto-increments. The polled bytes (command and address) go
+ *   through USART_SpiTransfer, the data bytes through the two DMA
+ *   channels. A DMA cycle completes when simDmaComplete is called or when
+ *   the MCU "sleeps" in EM1 (like the DMA interrupt would wake it up).
+ *
+ *   The util methods are also replaced: Delay advances msTicks instead of
+ *   waiting for it.
+ ******************************************************************************/
+
+
+#include <string.h>
+
+#include "sim.h"
+
+#include "../inc/accel.h"
+#include "../inc/util.h"
+
+
+/* Simulated hardware */
+uint8_t simPolled[SIM_POLLED_SIZE];
+uint8_t simPolledCount;
+uint8_t simRegs[SIM_REGS_SIZE];
+uint8_t simFifo[SIM_FIFO_SIZE];
+uint16_t simFifoPos;
+uint16_t simCsFalls;
+uint16_t simCs2Falls;
+uint16_t simFifoFlushes;
+uint16_t simDmaCycles;
+SIM_DmaChannel_TypeDef simDma[2];
+uint32_t simRtc;
+
+
+/* Peripherals */
+static USART_TypeDef usart0, usart1;
+static RTC_TypeDef rtc;
+static SysTick_Type sysTick;
+static TIMER_TypeDef timer0, timer1;
+
+USART_TypeDef *USART0 = &usart0, *USART1 = &usart1;
+RTC_TypeDef *RTC = &rtc;
+SysTick_Type *SysTick = &sysTick;
+TIMER_TypeDef *TIMER0 = &timer0, *TIMER1 = &timer1;
+
+
+/* Local variables */
+static bool pins[6][16];
+static DMA_CB_TypeDef *dmaCallbacks[2];
+static uint8_t spiState;  /* 0 = command, 1 = address, 2 = data */
+static uint8_t spiCommand;
+static uint8_t spiAddress;
+static uint32_t rtcCompare[2];
+
+
+/* Replaced util methods and variables */
+volatile uint32_t msTicks = 0;
+
+
+/**************************************************************************//**
+ * @brief
+ *   Put the simulated hardware in its reset state.
+ *****************************************************************************/
+void simReset (void)
+{
+	memset(simPolled, 0, sizeof(simPolled));
+	simPolledCount = 0;
+	memset(simRegs, 0, sizeof(simRegs));
+	memset(simFifo, 0, sizeof(simFifo));
+	simFifoPos = 0;
+	simCsFalls = 0;
+	simCs2Falls = 0;
+	simFifoFlushes = 0;
+	simDmaCycles = 0;
+	memset(simDma, 0, sizeof(simDma));
+	simRtc = 0;
+	spiState = 0;
+
+	/* ID registers and reset values */
+	simRegs[ADXL_REG_DEVID_AD] = 0xAD;
+	simRegs[ADXL_REG_DEVID_MST] = 0x1D;
+	simRegs[ADXL_REG_PARTID] = 0xF2;
+	simRegs[ADXL_REG_REVID] = 0x01;
+	simRegs[ADXL_REG_FIFO_SAMPLES] = 0x80;
+	simRegs[ADXL_REG_FILTER_CTL] = 0x13;
+
+	/* CS pins idle high */
+	for (uint8_t port = 0; port < 6; port++)
+	{
+		for (uint8_t pin = 0; pin < 16; pin++) pins[port][pin] = true;
+	}
+}
+
+
+/**************************************************************************//**
+ * @brief
+ *   Get the output level of a pin.
+ *****************************************************************************/
+bool simPin (GPIO_Port_TypeDef port, unsigned int pin)
+{
+	return (pins[port][pin]);
+}
+
+
+/**************************************************************************//**
+ * @brief
+ *   Clock out one data byte to the accelerometer.
+ *
+ * @param[in] tx
+ *   The byte on MOSI.
+ *
+ * @return
+ *   The byte on MISO.
+ *****************************************************************************/
+static uint8_t slaveData (uint8_t tx)
+{
+	uint8_t rx = 0x00;
+
+	if (spiCommand == ADXL_CMD_WRITE_REG)
+	{
+		simRegs[spiAddress % SIM_REGS_SIZE] = tx;
+
+		/* A register write clears ERR_USER_REGS */
+		simRegs[ADXL_REG_STATUS] &= 0b01111111;
+
+		/* Disabling the FIFO clears it */
+		if ((spiAddress == ADXL_REG_FIFO_CONTROL) && ((tx & 0b11) == ADXL_FIFO_DISABLED))
+		{
+			simRegs[ADXL_REG_FIFO_ENTRIES_L] = 0;
+			simRegs[ADXL_REG_FIFO_ENTRIES_H] = 0;
+			simFifoPos = 0;
+			simFifoFlushes++;
+		}
+	}
+	else if (spiCommand == ADXL_CMD_READ_REG) rx = simRegs[spiAddress % SIM_REGS_SIZE];
+	else if (spiCommand == ADXL_CMD_READ_FIFO) rx = simFifo[simFifoPos++ % SIM_FIFO_SIZE];
+
+	spiAddress++;
+
+	return (rx);
+}
+
+
+/**************************************************************************//**
+ * @brief
+ *   Finish the active DMA cycle and call the callback of the RX channel.
+ *
+ * @return
+ *   @li true - A cycle was finished.
+ *   @li false - No DMA cycle was active.
+ *****************************************************************************/
+bool simDmaComplete (void)
+{
+	SIM_DmaChannel_TypeDef *rx = &simDma[ADXL_DMA_CH_RX];
+	SIM_DmaChannel_TypeDef *tx = &simDma[ADXL_DMA_CH_TX];
+
+	if (!rx->active || !tx->active) return (false);
+
+	for (unsigned int i = 0; i <= tx->nMinus1; i++)
+	{
+		uint8_t byte = slaveData(tx->srcInc ? tx->src[i] : tx->src[0]);
+
+		if (rx->dstInc) rx->dst[i] = byte;
+		else rx->dst[0] = byte;
+	}
+
+	/* The callback can start the next cycle */
+	rx->active = false;
+	tx->active = false;
+
+	if ((dmaCallbacks[ADXL_DMA_CH_RX] != NULL) && (dmaCallbacks[ADXL_DMA_CH_RX]->cbFunc != NULL))
+	{
+		dmaCallbacks[ADXL_DMA_CH_RX]->cbFunc(ADXL_DMA_CH_RX, true, dmaCallbacks[ADXL_DMA_CH_RX]->userPtr);
+	}
+
+	return (true);
+}
+
+
+/* GPIO */
+void GPIO_PinModeSet (GPIO_Port_TypeDef port, unsigned int pin, GPIO_Mode_TypeDef mode, unsigned int out)
+{
+	(void) mode;
+	pins[port][pin] = (out != 0);
+}
+
+void GPIO_PinOutSet (GPIO_Port_TypeDef port, unsigned int pin)
+{
+	pins[port][pin] = true;
+}
+
+void GPIO_PinOutClear (GPIO_Port_TypeDef port, unsigned int pin)
+{
+	/* A falling edge on CS starts a new command */
+	if (pins[port][pin] && (port == ADXL_NCS_PORT) && (pin == ADXL_NCS_PIN))
+	{
+		spiState = 0;
+		simCsFalls++;
+	}
+
+	/* The other accelerometers answer from the same registers */
+	if (pins[port][pin] && (port == ADXL2_NCS_PORT) && (pin == ADXL2_NCS_PIN))
+	{
+		spiState = 0;
+		simCs2Falls++;
+	}
+
+	pins[port][pin] = false;
+}
+
+void GPIO_PinOutToggle (GPIO_Port_TypeDef port, unsigned int pin)
+{
+	pins[port][pin] = !pins[port][pin];
+}
+
+unsigned int GPIO_PinInGet (GPIO_Port_TypeDef port, unsigned int pin)
+{
+	(void) port;
+	(void) pin;
+	return (0);
+}
+
+uint32_t GPIO_IntGet (void) { return (0); }
+void GPIO_IntClear (uint32_t flags) { (void) flags; }
+void GPIO_IntConfig (GPIO_Port_TypeDef port, unsigned int pin, bool rising, bool falling, bool enable) { (void) port; (void) pin; (void) rising; (void) falling; (void) enable; }
+void GPIO_IntEnable (uint32_t flags) { (void) flags; }
+void GPIO_IntDisable (uint32_t flags) { (void) flags; }
+
+
+/* USART */
+void USART_InitSync (USART_TypeDef *usart, const USART_InitSync_TypeDef *init) { (void) usart; (void) init; }
+void USART_Enable (USART_TypeDef *usart, USART_Enable_TypeDef enable) { (void) usart; (void) enable; }
+
+uint8_t USART_SpiTransfer (USART_TypeDef *usart, uint8_t data)
+{
+	(void) usart;
+
+	if (simPolledCount < SIM_POLLED_SIZE) simPolled[simPolledCount++] = data;
+
+	if (spiState == 0)
+	{
+		spiCommand = data;
+		spiState = (data == ADXL_CMD_READ_FIFO) ? 2 : 1;
+		return (0x00);
+	}
+	else if (spiState == 1)
+	{
+		spiAddress = data;
+		spiState = 2;
+		return (0x00);
+	}
+	else return (slaveData(data));
+}
+
+
+/* DMA */
+void DMA_Init (DMA_Init_TypeDef *init) { (void) init; }
+
+void DMA_CfgChannel (unsigned int channel, DMA_CfgChannel_TypeDef *cfg)
+{
+	if (channel < 2) dmaCallbacks[channel] = cfg->cb;
+}
+
+void DMA_CfgDescr (unsigned int channel, bool primary, DMA_CfgDescr_TypeDef *cfg)
+{
+	(void) primary;
+
+	if (channel >= 2) return;
+
+	simDma[channel].dstInc = (cfg->dstInc != dmaDataIncNone);
+	simDma[channel].srcInc = (cfg->srcInc != dmaDataIncNone);
+}
+
+void DMA_ActivateBasic (unsigned int channel, bool primary, bool useBurst, void *dst, const void *src, unsigned int nMinus1)
+{
+	(void) primary;
+	(void) useBurst;
+
+	if (channel >= 2) return;
+
+	simDma[channel].active = true;
+	simDma[channel].dst = (uint8_t *)dst;
+	simDma[channel].src = (const uint8_t *)src;
+	simDma[channel].nMinus1 = nMinus1;
+
+	if (channel == ADXL_DMA_CH_TX) simDmaCycles++;
+}
+
+bool DMA_ChannelEnabled (unsigned int channel)
+{
+	return ((channel < 2) && simDma[channel].active);
+}
+
+
+/* EMU: sleeping lets the DMA finish (its interrupt wakes the MCU) or lets time pass */
+void EMU_EnterEM1 (void)
+{
+	if (!simDmaComplete())
+	{
+		simRtc++;
+		msTicks++;
+	}
+}
+
+void EMU_EnterEM2 (bool restore)
+{
+	(void) restore;
+	EMU_EnterEM1();
+}
+
+
+/* RTC */
+void RTC_Init (const RTC_Init_TypeDef *init) { (void) init; }
+void RTC_CounterReset (void) { simRtc = 0; }
+uint32_t RTC_CounterGet (void) { return (simRtc); }
+void RTC_CompareSet (unsigned int comp, uint32_t value) { rtcCompare[comp & 1] = value; }
+uint32_t RTC_CompareGet (unsigned int comp) { return ((comp == 0) && (rtcCompare[0] == 0) ? RTC_CNT_CNT_MASK : rtcCompare[comp & 1]); }
+void RTC_IntClear (uint32_t flags) { (void) flags; }
+void RTC_IntEnable (uint32_t flags) { (void) flags; }
+void RTC_IntDisable (uint32_t flags) { (void) flags; }
+uint32_t RTC_IntGet (void) { return (0); }
+
+
+/* CMU, MSC, CHIP, NVIC and core */
+void CMU_ClockEnable (CMU_Clock_TypeDef clock, bool enable) { (void) clock; (void) enable; }
+uint32_t CMU_ClockFreqGet (CMU_Clock_TypeDef clock) { (void) clock; return (14000000); }
+void CMU_OscillatorEnable (CMU_Osc_TypeDef osc, bool enable, bool wait) { (void) osc; (void) enable; (void) wait; }
+void CMU_ClockSelectSet (CMU_Clock_TypeDef clock, CMU_Select_TypeDef ref) { (void) clock; (void) ref; }
+void MSC_Init (void) { }
+void MSC_Deinit (void) { }
+MSC_Status_TypeDef MSC_ErasePage (uint32_t *address) { (void) address; return (mscReturnOk); }
+MSC_Status_TypeDef MSC_WriteWord (uint32_t *address, const void *data, uint32_t bytes) { (void) address; (void) data; (void) bytes; return (mscReturnOk); }
+void CHIP_Init (void) { }
+void NVIC_SetPriority (int irq, uint32_t priority) { (void) irq; (void) priority; }
+void NVIC_EnableIRQ (IRQn_Type irq) { (void) irq; }
+void NVIC_DisableIRQ (IRQn_Type irq) { (void) irq; }
+void NVIC_ClearPendingIRQ (IRQn_Type irq) { (void) irq; }
+uint32_t SysTick_Config (uint32_t ticks) { (void) ticks; return (0); }
+void __disable_irq (void) { }
+void __enable_irq (void) { }
+void __WFI (void) { }
+void __NOP (void) { }
+
+
+/* util */
+void initLEDS (void) { }
+void led0 (bool enabled) { (void) enabled; }
+void Error (uint8_t number) { (void) number; }
+void Delay (uint32_t dlyTicks) { msTicks += dlyTicks; simRtc += (dlyTicks * ADXL_SYNC_CLOCK) / 1000; }
+void systickInterrupts (bool enabled) { (void) enabled; }
+
+
+/* dbprint (no output) */
+void dbprint_INIT (USART_TypeDef *pointer, uint8_t location, bool vcom, bool interrupts) { (void) pointer; (void) location; (void) vcom; (void) interrupts; }
+void dbprint (char *message) { (void) message; }
+void dbprintln (char *message) { (void) message; }
+void dbprintInt (int32_t value) { (void) value; }
+void dbprintlnInt (int32_t value) { (void) value; }
+void dbprintInt_hex (int32_t value) { (void) value; }
+void dbprintlnInt_hex (int32_t value) { (void) value; }
+void dbprint_color (char *message, uint8_t color) { (void) message; (void) color; }
+void dbinfo (char *message) { (void) message; }
+void dbwarn (char *message) { (void) message; }
+void dbcrit (char *message) { (void) message; }
+void dbinfoInt (char *message1, int32_t value, char *message2) { (void) message1; (void) value; (void) message2; }
+void dbwarnInt (char *message1, int32_t value, char *message2) { (void) message1; (void) value; (void) message2; }
+void dbcritInt (char *message1, int32_t value, char *message2) { (void) message1; (void) value; (void) message2; }
+void dbinfoInt_hex (char *message1, int32_t value, char *message2) { (void) message1; (void) value; (void) message2; }
+void dbwarnInt_hex (char *message1, int32_t value, char *message2) { (void) message1; (void) value; (void) message2; }
+void dbcritInt_hex (char *message1, int32_t value, char *message2) { (void) message1; (void) value; (void) message2; }
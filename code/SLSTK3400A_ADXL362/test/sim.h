@@ -0,0 +1,64 @@
+/***************************************************************************//**
+ * @file sim.h
+ * @brief Simulated GPIO, USART0, DMA, RTC and ADXL362 for the host tests.
+ ******************************************************************************/
+
+
+/* Include guards prevent multiple inclusions of the same header */
+#ifndef _SIM_H_
+#define _SIM_H_
+
+
+#include <stdint.h>  	/* (u)intXX_t */
+#include <stdbool.h> 	/* "bool", "true", "false" */
+#include "em_gpio.h"
+
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+
+/* Sizes of the logs and of the simulated accelerometer */
+#define SIM_POLLED_SIZE 		64
+#define SIM_REGS_SIZE 			64
+#define SIM_FIFO_SIZE 			2048
+
+
+/* State of one DMA channel */
+typedef struct
+{
+	bool active;
+	bool dstInc;
+	bool srcInc;
+	uint8_t *dst;
+	const uint8_t *src;
+	unsigned int nMinus1;
+} SIM_DmaChannel_TypeDef;
+
+
+/* Simulated hardware, freely inspected and modified by the tests */
+extern uint8_t simPolled[SIM_POLLED_SIZE]; /* Bytes sent with USART_SpiTransfer */
+extern uint8_t simPolledCount;
+extern uint8_t simRegs[SIM_REGS_SIZE];     /* Registers of the accelerometer */
+extern uint8_t simFifo[SIM_FIFO_SIZE];     /* Bytes clocked out by the read FIFO command */
+extern uint16_t simFifoPos;
+extern uint16_t simFifoFlushes;            /* FIFO_CONTROL writes with the FIFO disabled */
+extern uint16_t simCsFalls;                /* Falling edges on the CS pin of the accelerometer */
+extern uint16_t simCs2Falls;               /* Falling edges on ADXL2_NCS (second accelerometer) */
+extern uint16_t simDmaCycles;              /* DMA cycles activated */
+extern SIM_DmaChannel_TypeDef simDma[2];   /* ADXL_DMA_CH_RX and ADXL_DMA_CH_TX */
+extern uint32_t simRtc;                    /* RTC counter */
+
+
+void simReset (void);
+bool simPin (GPIO_Port_TypeDef port, unsigned int pin);
+bool simDmaComplete (void);
+
+
+#ifdef __cplusplus
+}
+#endif
+
+
+#endif /* _SIM_H_ */
@@ -0,0 +1,141 @@
+/***************************************************************************//**
+ * @file test_driver.cpp
+ * @brief Host tests of the header-only C++ driver.
+ *
+ * @details
+ *   Compiles "ADXL362.hpp" and runs it on top of "accel.c" and the
+ *   simulated hardware of "sim.c". Checks the compile-time constants, the
+ *   bursts and the device handles (default CS pin and a second one).
+ ******************************************************************************/
+
+
+#include <stdio.h>
+
+#include "sim.h"
+
+#include "../inc/ADXL362.hpp"
+
+
+using namespace adxl362;
+
+
+/* Second accelerometer, other range and ODR than the board */
+typedef Driver<ADXL2_NCS_PORT, ADXL2_NCS_PIN, Range::G8, ODR::Hz400, false> Second;
+
+
+/* Compile-time constants */
+static_assert(Board::FILTER_CTL == 0b01010000, "Board FILTER_CTL (+-4g, 12.5 Hz, ODR/4)");
+static_assert(Board::MG_PER_LSB == 2, "Board mg/LSB");
+static_assert(Board::thresholdCodes(1000) == 500, "Board threshold codes");
+static_assert(Second::FILTER_CTL == 0b10000101, "Second FILTER_CTL (+-8g, 400 Hz, ODR/2)");
+static_assert(Second::RATE_MHZ == 400000UL, "Second rate");
+static_assert(Second::PERIOD_TICKS == 81, "Second sample period");
+
+
+/* Failed checks */
+static int failures = 0;
+
+#define CHECK(condition) do { if (!(condition)) { failures++; printf("%s:%d: CHECK(%s) failed\n", __FILE__, __LINE__, #condition); } } while (0)
+
+
+/**************************************************************************//**
+ * @brief
+ *   Reset the simulation and the driver.
+ *****************************************************************************/
+static void setup (void)
+{
+	simReset();
+	initADXL_VCC();
+	initADXL_SPI();
+}
+
+
+/**************************************************************************//**
+ * @brief
+ *   Board: FILTER_CTL and POWER_CTL in one burst on the default device,
+ *   X-Y-Z converted with the factor of the range.
+ *****************************************************************************/
+static void testBoard (void)
+{
+	int16_t mg[3];
+
+	setup();
+
+	CHECK(Board::init());
+	CHECK(Board::device() == getDefaultDeviceADXL());
+
+	Board::configure(Mode::Measure);
+
+	CHECK(simPolledCount == 2);
+	CHECK(simPolled[0] == ADXL_CMD_WRITE_REG);
+	CHECK(simPolled[1] == ADXL_REG_FILTER_CTL);
+	CHECK(simCsFalls == 1);
+	CHECK(simRegs[ADXL_REG_FILTER_CTL] == Board::FILTER_CTL);
+	CHECK(simRegs[ADXL_REG_POWER_CTL] == 0b00000010);
+	CHECK(getShadowADXL(ADXL_REG_FILTER_CTL) == Board::FILTER_CTL);
+
+	/* 16, -16 and 250 codes */
+	simRegs[ADXL_REG_XDATA_L] = 0x10;
+	simRegs[ADXL_REG_XDATA_H] = 0x00;
+	simRegs[ADXL_REG_YDATA_L] = 0xF0;
+	simRegs[ADXL_REG_YDATA_H] = 0xFF;
+	simRegs[ADXL_REG_ZDATA_L] = 0xFA;
+	simRegs[ADXL_REG_ZDATA_H] = 0x00;
+
+	Board::readXYZ(mg);
+
+	CHECK(mg[0] == 32);
+	CHECK(mg[1] == -32);
+	CHECK(mg[2] == 500);
+}
+
+
+/**************************************************************************//**
+ * @brief
+ *   Second device: its own CS pin and shadow, the transfers don't depend
+ *   on the device selected in the C driver.
+ *****************************************************************************/
+static void testSecondDevice (void)
+{
+	setup();
+
+	CHECK(Second::init());
+	CHECK(Second::device() != getDefaultDeviceADXL());
+
+	uint8_t before = getShadowADXL(ADXL_REG_FILTER_CTL);
+
+	Second::configure(Mode::Measure);
+
+	CHECK(simCs2Falls == 1);
+	CHECK(simCsFalls == 0);
+	CHECK(simPin(ADXL2_NCS_PORT, ADXL2_NCS_PIN));
+	CHECK(simRegs[ADXL_REG_FILTER_CTL] == Second::FILTER_CTL);
+	CHECK(Second::device()->shadow[ADXL_REG_FILTER_CTL - ADXL_SHADOW_FIRST] == Second::FILTER_CTL);
+	CHECK(getShadowADXL(ADXL_REG_FILTER_CTL) == before);
+
+	/* The board keeps talking to the default device */
+	selectADXL(Second::device());
+	Board::write(Reg::TIME_ACT, 7);
+	selectADXL(NULL);
+
+	CHECK(simCsFalls == 1);
+	CHECK(simCs2Falls == 1);
+	CHECK(getShadowADXL(ADXL_REG_TIME_ACT) == 7);
+	CHECK(Second::device()->shadow[ADXL_REG_TIME_ACT - ADXL_SHADOW_FIRST] == 0);
+
+	/* init is idempotent: no extra device slots, the shadow is kept */
+	for (uint8_t i = 0; i < ADXL_MAX_DEVICES; i++) CHECK(Second::init());
+	CHECK(Second::device()->shadow[ADXL_REG_FILTER_CTL - ADXL_SHADOW_FIRST] == Second::FILTER_CTL);
+}
+
+
+int main (void)
+{
+	testBoard();
+	testSecondDevice();
+
+	if (failures == 0) printf("test_driver: all checks passed\n");
+	else printf("test_driver: %d check(s) failed\n", failures);
+
+	return ((failures == 0) ? 0 : 1);
+}
@@ -0,0 +1,427 @@
+/***************************************************************************//**
+ * @file test_transport.c
+ * @brief Host tests of the SPI/DMA transport of the accelerometer driver.
+ *
+ * @details
+ *   Runs "accel.c" against the simulated USART0, DMA and ADXL362 of
+ *   "sim.c". Checks the polled command and address bytes, the RX/TX DMA
+ *   cycles, CS, the transaction queue and the shadow.
+ ******************************************************************************/
+
+
+#include <stdio.h>
+#include <string.h>
+
+#include "sim.h"
+
+#include "../inc/accel.h"
+
+
+/* Range of the selected accelerometer ("accel.c") */
+extern uint8_t range;
+
+
+/* Failed checks */
+static int failures = 0;
+
+#define CHECK(condition) do { if (!(condition)) { failures++; printf("%s:%d: CHECK(%s) failed\n", __FILE__, __LINE__, #condition); } } while (0)
+
+
+/* Callback order of the queue test */
+static uint8_t callbackOrder[4];
+static uint8_t callbackCount;
+
+static void recordCallback (ADXL_Transaction_TypeDef *transaction)
+{
+	callbackOrder[callbackCount++] = *(uint8_t *)transaction->user;
+}
+
+
+/**************************************************************************//**
+ * @brief
+ *   Reset the simulation and the driver.
+ *****************************************************************************/
+static void setup (void)
+{
+	simReset();
+	initADXL_VCC();
+	initADXL_SPI();
+}
+
+
+/**************************************************************************//**
+ * @brief
+ *   Single register write: polled command and address, one TX byte by
+ *   DMA, CS high afterwards and the shadow (and range) updated.
+ *****************************************************************************/
+static void testWriteRegister (void)
+{
+	setup();
+
+	writeADXL(ADXL_REG_FILTER_CTL, 0b01010011); /* +-4g */
+
+	CHECK(simPolledCount == 2);
+	CHECK(simPolled[0] == ADXL_CMD_WRITE_REG);
+	CHECK(simPolled[1] == ADXL_REG_FILTER_CTL);
+	CHECK(simDmaCycles == 1);
+	CHECK(simCsFalls == 1);
+	CHECK(simPin(ADXL_NCS_PORT, ADXL_NCS_PIN));
+	CHECK(USART0->CMD == USART_CMD_CLEARRX);
+	CHECK(simRegs[ADXL_REG_FILTER_CTL] == 0b01010011);
+	CHECK(getShadowADXL(ADXL_REG_FILTER_CTL) == 0b01010011);
+	CHECK(range == 1);
+	CHECK(!queueBusyADXL());
+}
+
+
+/**************************************************************************//**
+ * @brief
+ *   Burst read: the RX channel fills the buffer, the shadow isn't touched.
+ *****************************************************************************/
+static void testBurstRead (void)
+{
+	uint8_t buffer[8];
+
+	setup();
+
+	for (uint8_t i = 0; i < 8; i++) simRegs[ADXL_REG_XDATA_L + i] = 0x10 + i;
+	memset(buffer, 0, sizeof(buffer));
+
+	burstReadADXL(ADXL_REG_XDATA_L, buffer, 8);
+
+	CHECK(simPolledCount == 2);
+	CHECK(simPolled[0] == ADXL_CMD_READ_REG);
+	CHECK(simPolled[1] == ADXL_REG_XDATA_L);
+	CHECK(simDmaCycles == 1);
+	for (uint8_t i = 0; i < 8; i++) CHECK(buffer[i] == 0x10 + i);
+	CHECK(simPin(ADXL_NCS_PORT, ADXL_NCS_PIN));
+	CHECK(getShadowADXL(ADXL_REG_FILTER_CTL) == 0x13);
+}
+
+
+/**************************************************************************//**
+ * @brief
+ *   Queue advance: only the first transaction is on the bus, the
+ *   completion of the RX channel starts the next one (new CS frame)
+ *   before the callback of the finished one is called.
+ *****************************************************************************/
+static void testQueueAdvance (void)
+{
+	uint8_t id[2] = { 1, 2 };
+	uint8_t value = 0x55;
+	uint8_t status = 0;
+
+	setup();
+	callbackCount = 0;
+	simRegs[ADXL_REG_STATUS] = 0x41;
+
+	ADXL_Transaction_TypeDef write = { ADXL_CMD_WRITE_REG, ADXL_REG_TIME_ACT, &value, 1, recordCallback, &id[0], true, NULL };
+	ADXL_Transaction_TypeDef read = { ADXL_CMD_READ_REG, ADXL_REG_STATUS, &status, 1, recordCallback, &id[1], true, NULL };
+
+	CHECK(queueADXL(&write));
+	CHECK(queueADXL(&read));
+
+	/* The shadow is updated when the write is queued */
+	CHECK(getShadowADXL(ADXL_REG_TIME_ACT) == 0x55);
+
+	/* Only the first one started */
+	CHECK(simPolledCount == 2);
+	CHECK(!simPin(ADXL_NCS_PORT, ADXL_NCS_PIN));
+	CHECK(!write.done && !read.done);
+	CHECK(queueBusyADXL());
+
+	CHECK(simDmaComplete());
+	CHECK(write.done && !read.done);
+	CHECK(callbackCount == 1 && callbackOrder[0] == 1);
+	CHECK(simRegs[ADXL_REG_TIME_ACT] == 0x55);
+	CHECK(simPolledCount == 4);
+	CHECK(simPolled[2] == ADXL_CMD_READ_REG);
+	CHECK(simPolled[3] == ADXL_REG_STATUS);
+	CHECK(simCsFalls == 2);
+	CHECK(!simPin(ADXL_NCS_PORT, ADXL_NCS_PIN));
+
+	CHECK(simDmaComplete());
+	CHECK(read.done);
+	CHECK(status == 0x41);
+	CHECK(callbackCount == 2 && callbackOrder[1] == 2);
+	CHECK(simPin(ADXL_NCS_PORT, ADXL_NCS_PIN));
+	CHECK(!queueBusyADXL());
+	CHECK(!simDmaComplete());
+}
+
+
+/**************************************************************************//**
+ * @brief
+ *   A full queue refuses transactions until one finished.
+ *****************************************************************************/
+static void testQueueFull (void)
+{
+	ADXL_Transaction_TypeDef transactions[ADXL_QUEUE_SIZE + 1];
+	uint8_t buffer[ADXL_QUEUE_SIZE + 1];
+
+	setup();
+
+	for (uint8_t i = 0; i <= ADXL_QUEUE_SIZE; i++)
+	{
+		ADXL_Transaction_TypeDef transaction = { ADXL_CMD_READ_REG, ADXL_REG_STATUS, &buffer[i], 1, NULL, NULL, true, NULL };
+		transactions[i] = transaction;
+	}
+
+	for (uint8_t i = 0; i < ADXL_QUEUE_SIZE; i++) CHECK(queueADXL(&transactions[i]));
+	CHECK(!queueADXL(&transactions[ADXL_QUEUE_SIZE]));
+
+	CHECK(simDmaComplete());
+	CHECK(queueADXL(&transactions[ADXL_QUEUE_SIZE]));
+
+	waitQueueADXL();
+	for (uint8_t i = 0; i <= ADXL_QUEUE_SIZE; i++) CHECK(transactions[i].done);
+	CHECK(simCsFalls == ADXL_QUEUE_SIZE + 1);
+}
+
+
+/**************************************************************************//**
+ * @brief
+ *   The read FIFO command has no address byte, transfers longer than one
+ *   DMA cycle are split while CS stays low.
+ *****************************************************************************/
+static void testFifoSplit (void)
+{
+	static uint8_t buffer[ADXL_DMA_MAX_TRANSFERS + 100];
+	uint16_t length = sizeof(buffer);
+
+	setup();
+
+	for (uint16_t i = 0; i < length; i++) simFifo[i] = (uint8_t)(i * 7);
+
+	ADXL_Transaction_TypeDef fifo = { ADXL_CMD_READ_FIFO, 0x00, buffer, length, NULL, NULL, true, NULL };
+	CHECK(queueADXL(&fifo));
+
+	CHECK(simPolledCount == 1);
+	CHECK(simPolled[0] == ADXL_CMD_READ_FIFO);
+	CHECK(simDma[ADXL_DMA_CH_RX].nMinus1 == ADXL_DMA_MAX_TRANSFERS - 1);
+
+	CHECK(simDmaComplete());
+	CHECK(!fifo.done);
+	CHECK(!simPin(ADXL_NCS_PORT, ADXL_NCS_PIN));
+	CHECK(simCsFalls == 1);
+	CHECK(simDma[ADXL_DMA_CH_RX].nMinus1 == 99);
+
+	CHECK(simDmaComplete());
+	CHECK(fifo.done);
+	CHECK(simDmaCycles == 2);
+	CHECK(simPin(ADXL_NCS_PORT, ADXL_NCS_PIN));
+
+	bool same = true;
+	for (uint16_t i = 0; i < length; i++) if (buffer[i] != (uint8_t)(i * 7)) same = false;
+	CHECK(same);
+}
+
+
+/**************************************************************************//**
+ * @brief
+ *   A soft reset puts the shadow back at the reset values.
+ *****************************************************************************/
+static void testSoftResetShadow (void)
+{
+	setup();
+
+	writeADXL(ADXL_REG_FILTER_CTL, 0b10000000);
+	CHECK(range == 2);
+
+	writeADXL(ADXL_REG_SOFT_RESET, 0x52);
+	CHECK(getShadowADXL(ADXL_REG_FILTER_CTL) == 0x13);
+	CHECK(getShadowADXL(ADXL_REG_FIFO_SAMPLES) == 0x80);
+	CHECK(range == 0);
+}
+
+
+/**************************************************************************//**
+ * @brief
+ *   Power gating: the pins stay off while VCC is cut, the turn-on time is
+ *   slept (RTC) and the configuration is restored in one burst.
+ *****************************************************************************/
+static void testGatedRestore (void)
+{
+	setup();
+
+	writeADXL(ADXL_REG_TIME_ACT, 0x33);
+
+	powerDownADXL_gated();
+	CHECK(gatedADXL());
+	CHECK(!poweredADXL());
+	CHECK(!simPin(ADXL_VCC_PORT, ADXL_VCC_PIN));
+
+	/* Registers are lost without power */
+	simRegs[ADXL_REG_TIME_ACT] = 0x00;
+	simCsFalls = 0;
+
+	uint32_t start = simRtc;
+	uint32_t ticks = powerUpADXL_restore();
+
+	CHECK((simRtc - start) >= ADXL_MS_TO_TICKS(ADXL_POWERUP_WAIT));
+	CHECK(ticks >= ADXL_MS_TO_TICKS(ADXL_POWERUP_WAIT));
+	CHECK(!gatedADXL());
+	CHECK(poweredADXL());
+	CHECK(simPin(ADXL_VCC_PORT, ADXL_VCC_PIN));
+	CHECK(simCsFalls == 1);
+	CHECK(simRegs[ADXL_REG_TIME_ACT] == 0x33);
+	CHECK(powerUpADXL_restore() == 0);
+}
+
+
+/**************************************************************************//**
+ * @brief
+ *   Synchronized sampling starts with an empty FIFO, also if the FIFO was
+ *   already streaming (the shadow matches, the flush is written anyway).
+ *****************************************************************************/
+static void testSyncFlush (void)
+{
+	setup();
+
+	writeADXL(ADXL_REG_FIFO_CONTROL, ADXL_FIFO_STREAM);
+
+	/* 30 sets taken on the clock of the accelerometer */
+	simRegs[ADXL_REG_FIFO_ENTRIES_L] = 90;
+	simFifoPos = 12;
+
+	configADXL_sync(100);
+
+	CHECK(simFifoFlushes == 1);
+	CHECK(simRegs[ADXL_REG_FIFO_ENTRIES_L] == 0);
+	CHECK(simFifoPos == 0);
+	CHECK((simRegs[ADXL_REG_FIFO_CONTROL] & 0b11) == ADXL_FIFO_STREAM);
+	CHECK(simRegs[ADXL_REG_FILTER_CTL] & 0b00001000);
+	CHECK(readADXL_FIFOentries() == 0);
+
+	stopADXL_sync();
+}
+
+
+/**************************************************************************//**
+ * @brief
+ *   ERR_USER_REGS with matching registers: one harmless write clears it,
+ *   so it's only counted once.
+ *****************************************************************************/
+static void testHealthErrUserRegs (void)
+{
+	ADXL_Health_TypeDef before, after;
+
+	setup();
+	getHealthADXL(&before);
+
+	simRegs[ADXL_REG_STATUS] = 0b11000000;
+
+	CHECK(checkHealthADXL() == ADXL_HEALTH_REPAIRED);
+	CHECK((simRegs[ADXL_REG_STATUS] & 0b10000000) == 0);
+	CHECK(checkHealthADXL() == ADXL_HEALTH_OK);
+
+	getHealthADXL(&after);
+	CHECK(after.errUserRegs == (before.errUserRegs + 1));
+	CHECK(after.checks == (before.checks + 2));
+	CHECK(after.failures == before.failures);
+}
+
+
+/**************************************************************************//**
+ * @brief
+ *   Simulate one DATA_READY edge with new data and finish its read.
+ *****************************************************************************/
+static void dataReadyEdge (int16_t x, int16_t temp)
+{
+	simRegs[ADXL_REG_STATUS] = 0b00000001;
+	simRegs[ADXL_REG_XDATA_L] = x & 0xFF;
+	simRegs[ADXL_REG_XDATA_H] = (x >> 8) & 0xFF;
+	simRegs[ADXL_REG_TEMP_L] = temp & 0xFF;
+	simRegs[ADXL_REG_TEMP_H] = (temp >> 8) & 0xFF;
+
+	CHECK(dataReadyADXL());
+	CHECK(simDmaComplete());
+}
+
+
+/**************************************************************************//**
+ * @brief
+ *   DATA_READY with temperature compensation: readADXL_dataReady updates
+ *   the offsets with the newest temperature, the next samples use them.
+ *****************************************************************************/
+static void testDataReadyTemp (void)
+{
+	static const ADXL_TempPoint_TypeDef table[2] = { { 0, { 0, 0, 0 } }, { 1000, { 400, 0, 0 } } };
+	ADXL_Sample_TypeDef sample;
+
+	setup();
+	configADXL_tempComp(table, 2);
+	configADXL_dataReady(true);
+
+	/* No offsets until the first temperature is known */
+	dataReadyEdge(1000, 500);
+	CHECK(readADXL_dataReady(&sample, 1) == 1);
+	CHECK(sample.x == 1000);
+	CHECK(sample.temp == 500);
+
+	/* 200 mg at 500 LSB, 1 mg/LSB at +-2g */
+	dataReadyEdge(1000, 500);
+	CHECK(readADXL_dataReady(&sample, 1) == 1);
+	CHECK(sample.x == 800);
+
+	configADXL_dataReady(false);
+	configADXL_tempComp(NULL, 0);
+}
+
+
+/**************************************************************************//**
+ * @brief
+ *   DATA_READY missed samples: counted from the RTC gap in measurement
+ *   mode, not in wake-up mode (about 6 Hz whatever the ODR is) or on the
+ *   first sample after it.
+ *****************************************************************************/
+static void testDataReadyMissed (void)
+{
+	ADXL_DataReady_TypeDef stats;
+	uint32_t period = ADXL_SYNC_CLOCK / 100;
+
+	setup();
+	writeADXL(ADXL_REG_POWER_CTL, 0b00001010); /* Wake-up mode, 100 Hz ODR */
+	configADXL_dataReady(true);
+
+	for (uint8_t i = 0; i < 3; i++)
+	{
+		dataReadyEdge(0, 0);
+		simRtc += ADXL_SYNC_CLOCK / 6;
+	}
+
+	writeADXL(ADXL_REG_POWER_CTL, 0b00000010);
+
+	dataReadyEdge(0, 0);
+	simRtc += period;
+	dataReadyEdge(0, 0);
+	simRtc += 3 * period;
+	dataReadyEdge(0, 0);
+
+	getDataReadyADXL(&stats);
+	CHECK(stats.samples == 6);
+	CHECK(stats.missed == 2);
+
+	configADXL_dataReady(false);
+}
+
+
+int main (void)
+{
+	testWriteRegister();
+	testBurstRead();
+	testQueueAdvance();
+	testQueueFull();
+	testFifoSplit();
+	testSoftResetShadow();
+	testGatedRestore();
+	testSyncFlush();
+	testHealthErrUserRegs();
+	testDataReadyTemp();
+	testDataReadyMissed();
+
+	if (failures == 0) printf("test_transport: all checks passed\n");
+	else printf("test_transport: %d check(s) failed\n", failures);
+
+	return ((failures == 0) ? 0 : 1);
+}